@@ -1,37 +1,40 @@
 #include "ComplianceDashboard.hpp"
 #include <QtWidgets>
+#include <QtConcurrent>
+#include <algorithm>
+#include <numeric>
 
 ComplianceDashboard::ComplianceDashboard(PollutantModel *dataModel, QWidget *parent)
     : QWidget(parent), model(dataModel)
 {
+    dashboardUpdate = new RecomputeScheduler([this]() { updateDashboard(); }, this);
     setupInterface();
+
+    // the workers read the model's dataset, so stop them before it is
+    // replaced and start again once it is back
+    connect(model, &QAbstractItemModel::modelAboutToBeReset, this, [this]() {
+        restartAfterReset = !computeRuns.isEmpty() && computeRuns.last().isRunning();
+        cancelComputation();
+    });
+    connect(model, &QAbstractItemModel::modelReset, this, [this]() {
+        if (restartAfterReset)
+            dashboardUpdate->flush();
+        restartAfterReset = false;
+    });
+}
+
+ComplianceDashboard::~ComplianceDashboard()
+{
+    cancelComputation();
 }
 
-// This page takes a lot of load time. This function delays loading the data of the page, 
-// so that the main window can be displayed quickly if user does not navigate to this page.
+// Nothing is computed until the page is first shown, so that pages the
+// user never opens cost nothing.
 void ComplianceDashboard::showEvent(QShowEvent* event)
 {
     if (!isInitialized && model && model->hasData()) {
-        // create a loading dialog
-        loadingDialog = new QProgressDialog("Loading compliance data...", QString(), 0, 0, this);
-        loadingDialog->setWindowModality(Qt::WindowModal); 
-        loadingDialog->setAutoClose(true);  
-        loadingDialog->setCancelButton(nullptr);  
-        loadingDialog->setWindowTitle("Please Wait");
-        loadingDialog->setMinimumDuration(0); 
-        loadingDialog->show();
-
-        QTimer::singleShot(0, this, [this]() {
-            updatePollutantList();
-            isInitialized = true;
-            
-            // close the loading dialog
-            if (loadingDialog) {
-                loadingDialog->close();
-                delete loadingDialog;
-                loadingDialog = nullptr;
-            }
-        });
+        isInitialized = true;
+        updatePollutantList();
     }
     QWidget::showEvent(event);
 }
@@ -71,6 +74,12 @@ void ComplianceDashboard::setupInterface()
     rightPanelStats->setStyleSheet("QLabel { font-size: 12px; padding: 10px; }");
     mainLayout->addWidget(rightPanelStats);
 
+    // progress of the background computation, pollutants done / total
+    computeProgress = new QProgressBar();
+    computeProgress->setFormat(tr("Calculating compliance: %v / %m pollutants"));
+    computeProgress->hide();
+    mainLayout->addWidget(computeProgress);
+
     // table
     createTable();
     mainLayout->addWidget(dataTable, 1);
@@ -101,16 +110,15 @@ void ComplianceDashboard::createFilters()
 
 void ComplianceDashboard::createTable()
 {
-    dataTable = new QTableWidget(this);
-    dataTable->setColumnCount(5);
-    dataTable->setHorizontalHeaderLabels({"Pollutant",
-                                          "Average value",
-                                          "Unit",
-                                          "Compliant locations",
-                                          "Status"});
+    tableModel = new ComplianceTableModel(this);
+
+    dataTable = new QTableView(this);
+    dataTable->setModel(tableModel);
     dataTable->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
     dataTable->setAlternatingRowColors(true);
-    dataTable->setEditTriggers(QTableWidget::NoEditTriggers);
+    dataTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    dataTable->setSortingEnabled(true);
+    dataTable->sortByColumn(0, Qt::AscendingOrder);
 }
 
 void ComplianceDashboard::updateLocationSelector()
@@ -125,20 +133,14 @@ void ComplianceDashboard::updateLocationSelector()
     locationSelector->clear();
     locationSelector->addItem("All Locations");
 
-    QSet<QString> locations;
-    const auto &allData = model->getAllData();
-    for (const auto &record : allData)
+    for (const auto &location : model->uniqueLocations())
     {
-        if (!record.location.isEmpty())
+        if (!location.isEmpty())
         {
-            locations.insert(record.location);
+            locationSelector->addItem(location);
         }
     }
 
-    QStringList sortedLocations = locations.values();
-    sortedLocations.sort();
-    locationSelector->addItems(sortedLocations);
-
     int index = locationSelector->findText(currentLocation);
     if (index >= 0)
     {
@@ -150,7 +152,7 @@ void ComplianceDashboard::updateLocationSelector()
 
 void ComplianceDashboard::handleLocationChanged(const QString &location)
 {
-    updateDashboard();
+    dashboardUpdate->request();
 }
 
 void ComplianceDashboard::handleDateRangeChanged()
@@ -162,12 +164,14 @@ void ComplianceDashboard::handleDateRangeChanged()
     {
         endDateEdit->setDate(startDate.addDays(30));
     }
-    updateDashboard();
+    dashboardUpdate->request();
 }
 
+// The status filter only decides which results are shown, so running
+// work carries on and the table just selects the matching rows again.
 void ComplianceDashboard::handleComplianceFilterChanged(const QString &status)
 {
-    updateDashboard();
+    tableModel->setStatusFilter(status);
 }
 
 void ComplianceDashboard::updatePollutantList()
@@ -178,58 +182,107 @@ void ComplianceDashboard::updatePollutantList()
     }
 
     updateLocationSelector();
-    updateDashboard();
+    dashboardUpdate->flush();
 }
 
+// Restarts the computation for the current filters. The previous run is
+// cancelled but not waited for, so a filter change never blocks the GUI:
+// cancelling stops only the tasks that have not started, and whatever the
+// started ones still deliver belongs to an old generation and is dropped.
+// Such runs stay in computeRuns until they finish, so that
+// cancelComputation() can still wait for them before the dataset goes away.
 void ComplianceDashboard::updateDashboard()
 {
+    ++computeGeneration;
+    if (!computeRuns.isEmpty())
+        computeRuns.last().cancel();
+    computeRuns.removeIf([](const QFuture<ComplianceStatus>& run) { return run.isFinished(); });
+    tableModel->clear();
+
     if (!model || !model->hasData())
     {
-        statsLabel->clear();
-        rightPanelTitle->clear();
+        computeProgress->hide();
         rightPanelStats->clear();
         return;
     }
 
+    const PollutantDataset *dataset = &model->getDataset();
+    QString location = locationSelector->currentText();
+    bool allLocations = location == "All Locations";
+    int locationId = model->locationId(location);
+    qint64 startTime = toSampleTime(startDateEdit->dateTime());
+    qint64 endTime = toSampleTime(endDateEdit->dateTime().addDays(1));
+
+    // pollutants in name order, so results mostly arrive in table order
+    const StringDictionary &names = dataset->pollutantDictionary();
+    QList<int> pollutantIds(names.size());
+    std::iota(pollutantIds.begin(), pollutantIds.end(), 0);
+    std::sort(pollutantIds.begin(), pollutantIds.end(), [&names](int a, int b) {
+        return names.value(a) < names.value(b);
+    });
+
+    computeProgress->setRange(0, (int)pollutantIds.size());
+    computeProgress->setValue(0);
+    computeProgress->show();
     updateStatsPanel();
-    updateTable();
+
+    QFuture<ComplianceStatus> run = QtConcurrent::mapped(pollutantIds,
+        [dataset, allLocations, locationId, startTime, endTime](int pollutantId) {
+            return calculateStatus(*dataset, pollutantId, allLocations, locationId, startTime, endTime);
+        });
+    computeRuns.append(run);
+
+    auto *watcher = new QFutureWatcher<ComplianceStatus>(this);
+    int generation = computeGeneration;
+    connect(watcher, &QFutureWatcher<ComplianceStatus>::resultsReadyAt, this,
+            [this, watcher, generation](int begin, int end) {
+        if (generation == computeGeneration)
+            handleStatusesReady(watcher->future(), begin, end);
+    });
+    connect(watcher, &QFutureWatcher<ComplianceStatus>::progressValueChanged, this,
+            [this, generation](int value) {
+        if (generation == computeGeneration)
+            computeProgress->setValue(value);
+    });
+    connect(watcher, &QFutureWatcher<ComplianceStatus>::finished, this,
+            [this, watcher, generation]() {
+        if (generation == computeGeneration)
+            handleComputationFinished();
+        watcher->deleteLater();
+    });
+    watcher->setFuture(run);
 }
 
-void ComplianceDashboard::updateTable()
+// Only the destructor and a dataset swap wait here; filter changes go
+// through updateDashboard() and never block.
+void ComplianceDashboard::cancelComputation()
 {
-    dataTable->setRowCount(0);
-
-    const auto pollutants = model->uniquePollutants();
-    QString filterStatus = complianceFilter->currentText();
-
-    for (const auto &pollutant : pollutants) {
-        ComplianceStatus status = calculateStatus(pollutant);
-        if (status.totalSites == 0) continue;
-
-        if (filterStatus != "All" && status.status != filterStatus) {
-            continue;
-        }
+    ++computeGeneration;
+    for (QFuture<ComplianceStatus>& run : computeRuns)
+        run.cancel();
+    for (QFuture<ComplianceStatus>& run : computeRuns)
+        run.waitForFinished();
+    computeRuns.clear();
+    computeProgress->hide();
+}
 
-        int row = dataTable->rowCount();
-        dataTable->insertRow(row);
-
-        dataTable->setItem(row, 0, new QTableWidgetItem(status.pollutant));
-        dataTable->setItem(row, 1, new QTableWidgetItem(QString::number(status.averageValue, 'f', 2)));
-        dataTable->setItem(row, 2, new QTableWidgetItem(status.unit));
-        dataTable->setItem(row, 3, new QTableWidgetItem(QString("%1/%2")
-            .arg(status.totalSites - status.nonCompliantSites)
-            .arg(status.totalSites)));
-        
-        QTableWidgetItem* statusItem = new QTableWidgetItem(status.status);
-        if (status.status == "Compliant") {
-            statusItem->setForeground(QColor(0, 128, 0));  // green
-        } else if (status.status == "Warning") {
-            statusItem->setForeground(QColor(255, 165, 0));  // amber
-        } else {
-            statusItem->setForeground(QColor(255, 0, 0));  // red
+void ComplianceDashboard::handleStatusesReady(const QFuture<ComplianceStatus>& run, int begin, int end)
+{
+    std::vector<ComplianceStatus> batch;
+    for (int i = begin; i < end; ++i) {
+        ComplianceStatus status = run.resultAt(i);
+        if (status.totalSites > 0) {
+            batch.push_back(status);
         }
-        dataTable->setItem(row, 4, statusItem);
     }
+
+    tableModel->addStatuses(batch);
+    updateStatsPanel();
+}
+
+void ComplianceDashboard::handleComputationFinished()
+{
+    computeProgress->hide();
 }
 
 void ComplianceDashboard::updateStatsPanel()
@@ -240,6 +293,10 @@ void ComplianceDashboard::updateStatsPanel()
     }
 
     OverallStats stats = calculateOverallStats();
+    if (stats.totalPollutants == 0) {
+        rightPanelStats->clear();
+        return;
+    }
     double nonCompliantRate = static_cast<double>(stats.nonCompliantCount) / stats.totalPollutants;
     
     QString complianceStatus;
@@ -276,72 +333,60 @@ void ComplianceDashboard::updateStatsPanel()
 
 }
 
-ComplianceStatus ComplianceDashboard::calculateStatus(const QString &pollutant)
+// Reads one pollutant's totals per site over the days of the period from
+// the dataset's rollup cube, and turns the sites into a status. Runs on
+// worker threads, so it only reads the dataset.
+ComplianceStatus ComplianceDashboard::calculateStatus(const PollutantDataset &dataset, int pollutantId,
+                                                      bool allLocations, int locationId,
+                                                      qint64 startTime, qint64 endTime)
 {
     ComplianceStatus status;
-    status.pollutant = pollutant;
+    status.pollutant = dataset.pollutantDictionary().value(pollutantId);
     status.totalSites = 0;
     status.nonCompliantSites = 0;
     status.averageValue = 0.0;
-
-    const auto &data = model->getPollutantData(pollutant);
-    if (data.empty()) return status;
-
-    QMap<QString, QPair<double, bool>> siteData;
-    // store the count of samples for each site
-    QMap<QString, int> siteCount;
-
-    QString location = locationSelector->currentText();
-    QDateTime startDate = startDateEdit->dateTime();
-    QDateTime endDate = endDateEdit->dateTime().addDays(1);
-
-    // calculate the average value for each site
-    for (const auto &record : data) {
-        if (location != "All Locations" && record.location != location) {
-            continue;
-        }
-
-        QDateTime recordTime = QDateTime::fromString(record.time, Qt::ISODate);
-        if (!recordTime.isValid() || recordTime < startDate || recordTime > endDate) {
-            continue;
-        }
-
-        // update the site data
-        if (!siteData.contains(record.location)) {
-            siteData[record.location] = QPair<double, bool>(0.0, record.isComplianceSample);
-            siteCount[record.location] = 0;
-        }
-        siteData[record.location].first += record.result;
-        siteCount[record.location]++;
-        // set the site as non-compliant if any sample is non-compliant
-        if (!record.isComplianceSample) {
-            siteData[record.location].second = false;
-        }
+    status.percentile50 = 0.0;
+    status.percentile90 = 0.0;
+    status.percentile95 = 0.0;
+
+    const RollupCube &cube = dataset.rollupCube();
+    int firstSite = cube.findSite(pollutantId, locationId);
+    int lastSite = firstSite + 1;
+    if (allLocations) {
+        cube.pollutantSites(pollutantId, firstSite, lastSite);
+    } else if (firstSite < 0) {
+        return status;
     }
 
-    // calculate the total average value
-    double totalSum = 0.0;
-    int totalCount = 0;
-    status.totalSites = siteData.size();
-
-    for (auto it = siteData.begin(); it != siteData.end(); ++it) {
-        const QString& site = it.key();
-        double siteAverage = it.value().first / siteCount[site];
-        bool isCompliant = it.value().second;
+    // the period ends at the start of the day after the end date
+    int firstDay = sampleDay(startTime);
+    int endDay = sampleDay(endTime);
 
-        totalSum += siteAverage;
-        totalCount++;
-
-        if (!isCompliant) {
+    // the average value is the mean of the site averages, while the
+    // percentiles are over every sample of the sites
+    double totalSum = 0.0;
+    QuantileSketch distribution;
+    for (int site = firstSite; site < lastSite; ++site) {
+        RollupCell cell = cube.total(site, firstDay, endDay);
+        if (cell.isEmpty()) continue;
+
+        status.totalSites++;
+        totalSum += cell.mean();
+        distribution.merge(dataset.resultSketch(site, firstDay, endDay));
+        if (cell.complianceCount < cell.count) {
             status.nonCompliantSites++;
-            status.nonCompliantLocations.append(site);
+            status.nonCompliantLocations.append(dataset.locationDictionary().value(cube.siteLocation(site)));
         }
     }
+    if (status.totalSites == 0) return status;
+
+    status.unit = dataset.unit(dataset.pollutantRows(pollutantId).front());
+    status.averageValue = totalSum / status.totalSites;
+    distribution.compress();
+    status.percentile50 = distribution.quantile(0.50);
+    status.percentile90 = distribution.quantile(0.90);
+    status.percentile95 = distribution.quantile(0.95);
 
-    // set the status
-    status.averageValue = totalCount > 0 ? totalSum / totalCount : 0.0;
-    status.unit = !data.empty() ? data[0].unit : "";
-    
     // set overall status
     if (status.nonCompliantSites == 0) {
         status.status = "Compliant";
@@ -368,12 +413,8 @@ OverallStats ComplianceDashboard::calculateOverallStats()
     int totalSamples = 0;
     int compliantSamples = 0;
 
-    for (const auto &pollutant : model->uniquePollutants())
+    for (const auto &status : tableModel->statuses())
     {
-        ComplianceStatus status = calculateStatus(pollutant);
-        if (status.totalSites == 0)
-            continue;
-
         stats.totalPollutants++;
         totalSamples += status.totalSites;
         compliantSamples += (status.totalSites - status.nonCompliantSites);
@@ -1,13 +1,16 @@
 #pragma once
 
 #include <QWidget>
+#include <QFutureWatcher>
 #include "model.hpp"
-#include <QProgressDialog>
+#include "ComplianceTableModel.hpp"
+#include "RecomputeScheduler.hpp"
 
 class QComboBox;
 class QLabel;
 class QDateEdit;
-class QTableWidget;
+class QProgressBar;
+class QTableView;
 
 // to store overall statistics
 struct OverallStats {
@@ -18,24 +21,18 @@ struct OverallStats {
     double complianceRate = 0.0;
 };
 
-// to store compliance status
-struct ComplianceStatus {
-    QString pollutant;
-    double averageValue;
-    QString unit;
-    int totalSites;
-    int nonCompliantSites;
-    QVector<QString> nonCompliantLocations;
-    QString status;
-};
-
 class ComplianceDashboard : public QWidget
 {
     Q_OBJECT
 
     public:
         explicit ComplianceDashboard(PollutantModel* model, QWidget* parent = nullptr);
+        ~ComplianceDashboard();
         void updatePollutantList();
+        // stops every computation still running, including superseded
+        // ones, and waits for their worker threads, which read the model's
+        // dataset
+        void cancelComputation();
 
     protected:
         void showEvent(QShowEvent* event) override;
@@ -45,17 +42,20 @@ class ComplianceDashboard : public QWidget
         void handleDateRangeChanged();
         void handleComplianceFilterChanged(const QString& status);
         void updateDashboard();
+        void handleComputationFinished();
 
     private:
         void setupInterface();
         void createFilters();
         void createTable();
         void updateLocationSelector();
-        void updateTable();
         void updateStatsPanel();
-        ComplianceStatus calculateStatus(const QString& pollutant);
+        static ComplianceStatus calculateStatus(const PollutantDataset& dataset, int pollutantId,
+                                                bool allLocations, int locationId,
+                                                qint64 startTime, qint64 endTime);
         QString getComplianceStatus(double value);
         OverallStats calculateOverallStats();
+        void handleStatusesReady(const QFuture<ComplianceStatus>& run, int begin, int end);
 
         // UI components
         PollutantModel* model;
@@ -64,14 +64,27 @@ class ComplianceDashboard : public QWidget
         QDateEdit* startDateEdit;
         QDateEdit* endDateEdit;
         QLabel* statsLabel;
-        QTableWidget* dataTable;
+        QTableView* dataTable;
+        ComplianceTableModel* tableModel;
 
         // Right panel for detailed statistics
         QWidget* rightPanel;
         QLabel* rightPanelTitle;
         QLabel* rightPanelStats;
         QLabel* rightPanelInfo;
-        QProgressDialog* loadingDialog = nullptr;
+        QProgressBar* computeProgress;
+
+        // statuses are computed per pollutant on worker threads; the ones
+        // finished so far for the current filters go into tableModel,
+        // which the stats panel reads as well. Every run that may still
+        // have workers is kept, the current one last; each has its own
+        // watcher, which drops results from any run but the current
+        // computeGeneration.
+        QList<QFuture<ComplianceStatus>> computeRuns;
+        int computeGeneration = 0;
+        // merges location and date changes into one restart
+        RecomputeScheduler* dashboardUpdate;
+        bool restartAfterReset = false;
 
         // showEvent() flag
         bool isInitialized = false;  
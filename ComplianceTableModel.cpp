@@ -0,0 +1,179 @@
+#include "ComplianceTableModel.hpp"
+#include <QColor>
+#include <algorithm>
+
+void ComplianceTableModel::clear()
+{
+    beginResetModel();
+    allStatuses.clear();
+    shownRows.clear();
+    endResetModel();
+}
+
+// Statuses arrive in small batches while they are being computed, so each
+// one is inserted in place and announced as a single new row.
+void ComplianceTableModel::addStatuses(const std::vector<ComplianceStatus> &batch)
+{
+    for (const ComplianceStatus &status : batch) {
+        auto position = std::upper_bound(allStatuses.begin(), allStatuses.end(), status,
+            [this](const ComplianceStatus &a, const ComplianceStatus &b) { return lessThan(a, b); });
+        int index = (int)(position - allStatuses.begin());
+
+        auto shownPosition = std::lower_bound(shownRows.begin(), shownRows.end(), index);
+        for (auto it = shownPosition; it != shownRows.end(); ++it) {
+            (*it)++;
+        }
+
+        if (isShown(status)) {
+            int row = (int)(shownPosition - shownRows.begin());
+            beginInsertRows(QModelIndex(), row, row);
+            allStatuses.insert(position, status);
+            shownRows.insert(shownPosition, index);
+            endInsertRows();
+        } else {
+            allStatuses.insert(position, status);
+        }
+    }
+}
+
+void ComplianceTableModel::setStatusFilter(const QString &status)
+{
+    beginResetModel();
+    statusFilter = status;
+    selectRows();
+    endResetModel();
+}
+
+int ComplianceTableModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : (int)shownRows.size();
+}
+
+int ComplianceTableModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : 8;
+}
+
+QVariant ComplianceTableModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid()) {
+        return QVariant();
+    }
+
+    const ComplianceStatus &status = allStatuses[shownRows[index.row()]];
+
+    if (role == Qt::DisplayRole) {
+        switch (index.column()) {
+            case 0: return status.pollutant;
+            case 1: return QString::number(status.averageValue, 'f', 2);
+            case 2: return QString::number(status.percentile50, 'f', 2);
+            case 3: return QString::number(status.percentile90, 'f', 2);
+            case 4: return QString::number(status.percentile95, 'f', 2);
+            case 5: return status.unit;
+            case 6: return QString("%1/%2")
+                        .arg(status.totalSites - status.nonCompliantSites)
+                        .arg(status.totalSites);
+            case 7: return status.status;
+        }
+    } else if (role == Qt::ForegroundRole && index.column() == 7) {
+        if (status.status == "Compliant") {
+            return QColor(0, 128, 0);  // green
+        } else if (status.status == "Warning") {
+            return QColor(255, 165, 0);  // amber
+        } else {
+            return QColor(255, 0, 0);  // red
+        }
+    }
+
+    return QVariant();
+}
+
+QVariant ComplianceTableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (role != Qt::DisplayRole || orientation != Qt::Horizontal) {
+        return QVariant();
+    }
+
+    switch (section) {
+        case 0: return tr("Pollutant");
+        case 1: return tr("Average value");
+        case 2: return tr("P50");
+        case 3: return tr("P90");
+        case 4: return tr("P95");
+        case 5: return tr("Unit");
+        case 6: return tr("Compliant locations");
+        case 7: return tr("Status");
+    }
+    return QVariant();
+}
+
+void ComplianceTableModel::sort(int column, Qt::SortOrder order)
+{
+    beginResetModel();
+    sortColumn = column;
+    sortOrder = order;
+    std::stable_sort(allStatuses.begin(), allStatuses.end(),
+        [this](const ComplianceStatus &a, const ComplianceStatus &b) { return lessThan(a, b); });
+    selectRows();
+    endResetModel();
+}
+
+// Orders by the sort column, then by pollutant name so that equal values
+// keep a stable, readable order.
+bool ComplianceTableModel::lessThan(const ComplianceStatus &a, const ComplianceStatus &b) const
+{
+    const ComplianceStatus &first = sortOrder == Qt::AscendingOrder ? a : b;
+    const ComplianceStatus &second = sortOrder == Qt::AscendingOrder ? b : a;
+
+    switch (sortColumn) {
+        case 1:
+            if (first.averageValue != second.averageValue)
+                return first.averageValue < second.averageValue;
+            break;
+        case 2:
+            if (first.percentile50 != second.percentile50)
+                return first.percentile50 < second.percentile50;
+            break;
+        case 3:
+            if (first.percentile90 != second.percentile90)
+                return first.percentile90 < second.percentile90;
+            break;
+        case 4:
+            if (first.percentile95 != second.percentile95)
+                return first.percentile95 < second.percentile95;
+            break;
+        case 5:
+            if (first.unit != second.unit)
+                return first.unit < second.unit;
+            break;
+        case 6: {
+            int firstCompliant = first.totalSites - first.nonCompliantSites;
+            int secondCompliant = second.totalSites - second.nonCompliantSites;
+            if (firstCompliant != secondCompliant)
+                return firstCompliant < secondCompliant;
+            if (first.totalSites != second.totalSites)
+                return first.totalSites < second.totalSites;
+            break;
+        }
+        case 7:
+            if (first.status != second.status)
+                return first.status < second.status;
+            break;
+    }
+    return first.pollutant < second.pollutant;
+}
+
+bool ComplianceTableModel::isShown(const ComplianceStatus &status) const
+{
+    return statusFilter == "All" || status.status == statusFilter;
+}
+
+void ComplianceTableModel::selectRows()
+{
+    shownRows.clear();
+    for (int i = 0; i < (int)allStatuses.size(); ++i) {
+        if (isShown(allStatuses[i])) {
+            shownRows.push_back(i);
+        }
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <QAbstractTableModel>
+#include <QString>
+#include <QVector>
+#include <vector>
+
+// to store compliance status
+struct ComplianceStatus {
+    QString pollutant;
+    double averageValue;
+    // percentiles of every sample in the period, read from the rollup sketches
+    double percentile50;
+    double percentile90;
+    double percentile95;
+    QString unit;
+    int totalSites;
+    int nonCompliantSites;
+    QVector<QString> nonCompliantLocations;
+    QString status;
+};
+
+// Table of compliance statuses for a QTableView. The statuses are kept in
+// the current sort order and the rows shown are indices into them, so
+// sorting and status filtering never rebuild any widgets.
+class ComplianceTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+    public:
+        explicit ComplianceTableModel(QObject *parent = nullptr) : QAbstractTableModel(parent) {}
+
+        void clear();
+        // inserts each status at its place in the sort order
+        void addStatuses(const std::vector<ComplianceStatus> &batch);
+        // "All" shows every status, anything else only statuses equal to it
+        void setStatusFilter(const QString &status);
+        // every status added, shown or not, in sort order
+        const std::vector<ComplianceStatus> &statuses() const { return allStatuses; }
+
+        int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+        int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+        QVariant data(const QModelIndex &index, int role) const override;
+        QVariant headerData(int section, Qt::Orientation orientation, int role) const override;
+        void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override;
+
+    private:
+        bool lessThan(const ComplianceStatus &a, const ComplianceStatus &b) const;
+        bool isShown(const ComplianceStatus &status) const;
+        void selectRows();
+
+        std::vector<ComplianceStatus> allStatuses;
+        // indices into allStatuses of the rows shown, ascending
+        std::vector<int> shownRows;
+        QString statusFilter = "All";
+        int sortColumn = 0;
+        Qt::SortOrder sortOrder = Qt::AscendingOrder;
+};
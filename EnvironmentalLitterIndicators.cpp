@@ -89,29 +89,30 @@ void EnvironmentalLitterIndicators::updateComparisonChart()
     QString currentPollutant = pollutants->currentText();
 
     // Dynamic data structure
-    QMap<QString, double> compliantData;     
-    QMap<QString, double> nonCompliantData; 
-
-    // Initialize a variable to track the maximum value for y-axis
-    double maxValue = 0.0;
-
-    for (const auto &result : model->getAllData()) {
-        if (result.location != currentLocation ||
-            (result.type.toUpper() != currentType.toUpper() && currentType != "All Types") ||
-            result.pollutant != currentPollutant) {
-            continue;
-        }
-
-        QString time = result.time;
-        if (result.result >= 2.0) { // arbitrary value set as threshold 
-            nonCompliantData[time] += result.result; // non-compliant values
+    QMap<qint64, double> compliantData;     
+    QMap<qint64, double> nonCompliantData; 
+
+    const PollutantDataset &dataset = model->getDataset();
+    const auto &results = dataset.results();
+
+    RowQuery query;
+    query.pollutantIds = { model->pollutantId(currentPollutant) };
+    query.locationIds = { model->locationId(currentLocation) };
+    query.typeIds = matchingTypeIds(currentType);
+
+    RowBitmap rows = model->queryRows(query);
+    rows.forEach([&](int row) {
+        qint64 time = dataset.times()[row];
+        double value = results[row];
+        if (value >= 2.0) { // arbitrary value set as threshold 
+            nonCompliantData[time] += value; // non-compliant values
         } else {
-            compliantData[time] += result.result;   // compliant values
+            compliantData[time] += value;   // compliant values
         }
+    });
 
-        // Update maxValue if the current result is greater
-        maxValue = std::max(maxValue, result.result);
-    }
+    // The largest result sets the top of the y-axis
+    double maxValue = std::max(0.0, model->summarizeRows(rows).max);
 
 
     // Create a new chart
@@ -125,30 +126,20 @@ void EnvironmentalLitterIndicators::updateComparisonChart()
         return;
     }
 
-    QStringList times = compliantData.keys() + nonCompliantData.keys();
+    QList<qint64> times = compliantData.keys() + nonCompliantData.keys();
     std::sort(times.begin(), times.end());
 
-    // Split the time labels
+    // Format the time labels as the year over the time of day
     QStringList formattedTimes;
-    for (const QString &time : times) {
-        // Extract components from the time string
-        QStringList dateTimeParts = time.split('T'); // Split into date and time parts
-        if (dateTimeParts.size() == 2) {
-            QString datePart = dateTimeParts[0]; 
-            QString timePart = dateTimeParts[1]; 
-
-            // Further split the datePart into year, month, day
-            QStringList dateParts = datePart.split('-');
-            if (dateParts.size() == 3) {
-                QString year = dateParts[0];
-                QString formattedTime = QString("<b>%1</b><br>%2").arg(year, timePart.left(5));
-                formattedTimes.append(formattedTime);
-            } else {
-                formattedTimes.append(time); // Fallback: Add raw time if parsing fails
-            }
-        } else {
-            formattedTimes.append(time); // Fallback: Add raw time if parsing fails
+    for (qint64 time : times) {
+        if (time == InvalidSampleTime) {
+            formattedTimes.append(tr("Unknown")); // Fallback: sample time could not be parsed
+            continue;
         }
+
+        QDateTime dateTime = sampleDateTime(time);
+        QString formattedTime = QString("<b>%1</b><br>%2").arg(dateTime.toString("yyyy"), dateTime.toString("HH:mm"));
+        formattedTimes.append(formattedTime);
     }
 
 
@@ -160,7 +151,7 @@ void EnvironmentalLitterIndicators::updateComparisonChart()
     nonCompliantSet->setColor(QColor(255, 165, 0)); // Orange color (RGB)
 
     // Populate the bar sets with data for each time
-    for (const QString &time : times) {
+    for (qint64 time : times) {
         compliantSet->append(compliantData.value(time, 0.0));
         nonCompliantSet->append(nonCompliantData.value(time, 0.0));
     }
@@ -207,26 +198,42 @@ void EnvironmentalLitterIndicators::handleLocationChanged()
 
     pollutants->clear();
 
-    QStringList keywords = {
-    "BWP", "SewageDebris", "TarryResidus",
-    };
+    QSet<int> uniquePollutants; // To keep track of unique pollutant ids
+
+    const PollutantDataset &dataset = model->getDataset();
+    const auto &pollutantColumn = dataset.pollutantIds();
 
-    QSet<QString> uniquePollutants; // To keep track of unique pollutants
+    RowQuery query;
+    query.locationIds = { model->locationId(currentLocation) };
+    query.typeIds = matchingTypeIds(currentType);
 
-    for (const auto &result : model->getAllData()) {
-        if (result.location == currentLocation && (result.type.toUpper() == currentType.toUpper() || currentType == "All Types")) {
-            QString label = result.pollutant.toLower();
+    // Litter pollutants are classified once at load time
+    const StringDictionary &pollutantNames = dataset.pollutantDictionary();
+    for (int id = 0; id < pollutantNames.size(); ++id) {
+        if (dataset.pollutantCategories(id) & Litter) {
+            query.pollutantIds.push_back(id);
+        }
+    }
 
-            for (const QString &keyword : keywords) {
-                if (label.contains(keyword.toLower())) {
-                    if (!uniquePollutants.contains(result.pollutant)) {
-                        uniquePollutants.insert(result.pollutant); // Add to the set
-                        pollutants->addItem(result.pollutant); // Add to the QComboBox
-                    }
-                    break; // Exit the loop since a match is found
-                }
+    if (query.typeIds.empty()) {
+        // without a type filter the rollup cube already knows which
+        // pollutants were sampled at the location
+        const RollupCube &cube = dataset.rollupCube();
+        for (const CatalogEntry &pollutant : model->pollutantCatalog()) {
+            if ((dataset.pollutantCategories(pollutant.id) & Litter)
+                && cube.findSite(pollutant.id, query.locationIds.front()) >= 0) {
+                uniquePollutants.insert(pollutant.id);
+                pollutants->addItem(pollutant.name);
             }
         }
+    } else if (!query.pollutantIds.empty()) {
+        model->queryRows(query).forEach([&](int row) {
+            int pollutant = pollutantColumn[row];
+            if (!uniquePollutants.contains(pollutant)) {
+                uniquePollutants.insert(pollutant); // Add to the set
+                pollutants->addItem(pollutantNames.value(pollutant)); // Add to the QComboBox
+            }
+        });
     }
 
     if (uniquePollutants.isEmpty()) {
@@ -241,20 +248,26 @@ void EnvironmentalLitterIndicators::handleTypeChanged()
 
     locationFilter->clear();
 
-    QSet<QString> locations;
-    for (const auto &record : model->getAllData())
-    {   
-        if(currentType == "All Types" || record.type == currentType.toUpper())
-            locations.insert(record.location);
+    const PollutantDataset &dataset = model->getDataset();
+    std::vector<bool> present(dataset.locationDictionary().size(), currentType == "All Types");
+    if (currentType != "All Types")
+    {
+        // unlike the charts, the location list only takes rows whose type
+        // is exactly the upper-cased selection
+        RowQuery query;
+        query.typeIds = { dataset.typeDictionary().find(currentType.toUpper()) };
+        model->queryRows(query).forEach([&](int row) {
+            present[dataset.locationIds()[row]] = true;
+        });
     }
 
-    for (const auto &location : locations)
+    // the catalog is already in name order
+    for (const CatalogEntry &location : model->locationCatalog())
     {
-        locationFilter->addItem(location);
+        if (present[location.id])
+            locationFilter->addItem(location.name);
     }
 
-    locationFilter->model()->sort(0, Qt::AscendingOrder);
-
     locationFilter->setCurrentIndex(0);
 }
 
@@ -292,3 +305,25 @@ void EnvironmentalLitterIndicators::updateFromModel()
         waterType->addItem(label);
     }
 }
+
+// The charts compare material types case-insensitively, so collect the
+// type ids that match the selection for a row query. "All Types" leaves the query
+// unconstrained; a type with no match gives an id that selects nothing.
+std::vector<int> EnvironmentalLitterIndicators::matchingTypeIds(const QString &type) const
+{
+    std::vector<int> matches;
+    if (type == "All Types") {
+        return matches;
+    }
+
+    const StringDictionary &typeNames = model->getDataset().typeDictionary();
+    for (int id = 0; id < typeNames.size(); ++id) {
+        if (typeNames.value(id).toUpper() == type.toUpper()) {
+            matches.push_back(id);
+        }
+    }
+    if (matches.empty()) {
+        matches.push_back(StringDictionary::NotFound);
+    }
+    return matches;
+}
@@ -30,6 +30,7 @@ private:
     void createComparisonChart();
     void updateComparisonChart();
     void updateComplianceIndicator();
+    std::vector<int> matchingTypeIds(const QString &type) const;
 
 private slots:
     void handleLocationChanged();
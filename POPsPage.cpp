@@ -1,10 +1,12 @@
 #include "POPsPage.hpp"
 #include <QtWidgets>
+#include "ZoomableChartView.hpp"
 
 
 POPsPage::POPsPage(PollutantModel *dataModel, QWidget *parent)
     : QWidget(parent), model(dataModel)
 {
+    chartUpdate = new RecomputeScheduler([this]() { updateChart(); }, this);
     setupUI();
 
     tooltipLabel = new QLabel(this);
@@ -69,7 +71,7 @@ void POPsPage::createLocationSelector()
     locationSelector = new QComboBox();
     locationSelector->setMinimumWidth(200);
     connect(locationSelector, QOverload<const QString &>::of(&QComboBox::currentTextChanged),
-            this, &POPsPage::updateChart);
+            chartUpdate, &RecomputeScheduler::request);
 }
 
 void POPsPage::createPollutantSelector()
@@ -77,7 +79,7 @@ void POPsPage::createPollutantSelector()
     pollutantSelector = new QComboBox();
     pollutantSelector->setMinimumWidth(200);
     connect(pollutantSelector, QOverload<const QString &>::of(&QComboBox::currentTextChanged),
-            this, &POPsPage::updateChart);
+            chartUpdate, &RecomputeScheduler::request);
 }
 
 void POPsPage::createDateRangeSelector()
@@ -98,7 +100,7 @@ void POPsPage::createChart()
     chart->setTitle("POPs Concentration Over Time");
     chart->setAnimationOptions(QChart::SeriesAnimations);
 
-    chartView = new QChartView(chart);
+    chartView = new ZoomableChartView(chart);
     chartView->setRenderHint(QPainter::Antialiasing);
     chartView->setMinimumHeight(400);
 }
@@ -163,31 +165,7 @@ void POPsPage::handleDateRangeChanged()
     {
         endDateEdit->setDate(startDateEdit->date().addDays(5));
     }
-    updateChart();
-}
-
-bool POPsPage::isPOP(const QString &determinandLabel, const QString &definition)
-{
-    QString label = determinandLabel.toLower();
-    QString def = definition.toLower();
-
-    // dataset contains keywords for POPs
-    // to match against the label and definition
-    QStringList keywords = {
-        "organic", "org", "carbon",
-        "pcb", "dioxin", "furan",
-        "chlorinated", "pesticide",
-        "herbicide", "pollutant"};
-
-    for (const QString &keyword : keywords)
-    {
-        if (label.contains(keyword) || def.contains(keyword))
-        {
-            return true;
-        }
-    }
-
-    return false;
+    chartUpdate->request();
 }
 
 QString POPsPage::getRiskInfo(const QString &pollutant)
@@ -207,34 +185,39 @@ QString POPsPage::getRiskInfo(const QString &pollutant)
 
 POPsPage::Stats POPsPage::calculateStats(const QString& pollutant, const QString& location)
 {
-    Stats stats = {0, 0, 0, 0};  // initialize all values to 0
-    double sum = 0;
-    bool hasData = false;  // check if there is a vaild data point
-    
-    const auto& data = model->getPollutantData(pollutant);
-    for (const auto& record : data) {
-        if (location != "All Locations" && record.location != location) {
-            continue;
-        }
-        
-        if (!hasData) {
-            // first valid data point
-            stats.minValue = record.result;
-            stats.maxValue = record.result;
-            hasData = true;
-        } else {
-            stats.maxValue = std::max(stats.maxValue, record.result);
-            stats.minValue = std::min(stats.minValue, record.result);
-        }
-        
-        sum += record.result;
-        stats.sampleCount++;
+    Stats stats = {0, 0, 0, 0, 0, 0, 0};  // initialize all values to 0
+
+    // every sample of the pollutant at the site, or at each of its sites,
+    // is already totalled in the rollup cube
+    const RollupCube& cube = model->getDataset().rollupCube();
+    int pollutantId = model->pollutantId(pollutant);
+    int firstSite = cube.findSite(pollutantId, model->locationId(location));
+    int lastSite = firstSite + 1;
+    if (location == "All Locations") {
+        cube.pollutantSites(pollutantId, firstSite, lastSite);
+    } else if (firstSite < 0) {
+        return stats;
     }
-    
-    if (stats.sampleCount > 0) {
-        stats.average = sum / stats.sampleCount;
+
+    RollupCell total;
+    QuantileSketch distribution;
+    for (int site = firstSite; site < lastSite; ++site) {
+        total.merge(cube.siteTotal(site));
+        distribution.merge(cube.siteSketch(site));
     }
-    
+
+    if (!total.isEmpty()) {
+        stats.minValue = total.min;
+        stats.maxValue = total.max;
+        stats.average = total.mean();
+        stats.sampleCount = total.count;
+
+        distribution.compress();
+        stats.percentile50 = distribution.quantile(0.50);
+        stats.percentile90 = distribution.quantile(0.90);
+        stats.percentile95 = distribution.quantile(0.95);
+    }
+
     return stats;
 }
 
@@ -252,28 +235,17 @@ void POPsPage::updatePollutantList()
     locationSelector->clear();
 
     // update location selector
-    QSet<QString> locations;
-    for (const auto &record : model->getAllData())
-    {
-        locations.insert(record.location);
-    }
     locationSelector->addItem(tr("All Locations"));
-    
-    for (const auto &location : locations)
+
+    for (const auto &location : model->uniqueLocations())
     {
         locationSelector->addItem(location);
     }
 
-    locationSelector->model()->sort(0, Qt::AscendingOrder); // default Qt::AscendingOrder
-
-    // update pollutant selector
-    for (const auto &pollutant : model->uniquePollutants())
+    // update pollutant selector with the POPs classified at load time
+    for (const auto &pollutant : model->pollutantsInCategories(PersistentOrganic))
     {
-        QString definition = model->getPollutantDefinition(pollutant);
-        if (isPOP(pollutant, definition))
-        {
-            pollutantSelector->addItem(pollutant);
-        }
+        pollutantSelector->addItem(pollutant);
     }
 
     // restore previous selection
@@ -289,7 +261,7 @@ void POPsPage::updatePollutantList()
         locationSelector->setCurrentIndex(locationIndex);
     }
 
-    updateChart();
+    chartUpdate->flush();
     updateInfoPanel();
 }
 
@@ -308,84 +280,26 @@ void POPsPage::updateChart()
     connect(series, &QLineSeries::hovered,
             this, &POPsPage::handleHovered);
 
-    const auto &data = model->getPollutantData(selectedPollutant);
     QString selectedLocation = locationSelector->currentText();
-    QDateTime startDate = startDateEdit->dateTime();
-    QDateTime endDate = endDateEdit->dateTime().addDays(1);
-
-    QMap<qint64, QPair<double, int>> timeData;
-
-    // collect data points
-    for (const auto &record : data)
-    {
-        if (selectedLocation != "All Locations" && record.location != selectedLocation)
-        {
-            continue;
-        }
-
-        QDateTime recordTime = QDateTime::fromString(record.time, Qt::ISODate);
-        if (recordTime < startDate || recordTime > endDate)
-        {
-            continue;
-        }
-
-        qint64 timestamp = recordTime.toMSecsSinceEpoch();
-        QPair<double, int> &point = timeData[timestamp];
-        point.first += record.result;
-        point.second++;
-    }
-
-    // calculate average values and add to series
+    int pollutantId = model->pollutantId(selectedPollutant);
+    int locationId = selectedLocation == "All Locations" ? PollutantModel::AllLocations
+                                                         : model->locationId(selectedLocation);
+    std::shared_ptr<const SeriesPyramid> pyramid = model->getSeriesPyramid(pollutantId, locationId);
+    qint64 startTime = toSampleTime(startDateEdit->dateTime());
+    qint64 endTime = toSampleTime(endDateEdit->dateTime().addDays(1));
+    NodeRange samples = pyramid->samples(startTime, endTime);
+
+    // range of the average values
     double minY = std::numeric_limits<double>::max();
     double maxY = std::numeric_limits<double>::lowest();
 
-    for (auto it = timeData.begin(); it != timeData.end(); ++it)
+    for (const SeriesNode &sample : samples)
     {
-        double average = it.value().first / it.value().second;
-        series->append(it.key(), average);
-
-        minY = std::min(minY, average);
-        maxY = std::max(maxY, average);
+        minY = std::min(minY, sample.min);
+        maxY = std::max(maxY, sample.max);
     }
 
-    // get the chart and remove all old series
-    QChart *chart = chartView->chart();
-    chart->removeAllSeries();
-
-    // clear old axes
-    const auto oldAxes = chart->axes();
-    for (auto axis : oldAxes)
-    {
-        chart->removeAxis(axis);
-    }
-
-    chart->addSeries(series);
-
-    // create new axes
-    QDateTimeAxis *axisX = new QDateTimeAxis();
-    axisX->setFormat("yyyy-MM-dd");
-    axisX->setTitleText("Date");
-    axisX->setGridLineVisible(true);
-    axisX->setLabelsAngle(-45);
-    axisX->setTickCount(8);
-
-    QValueAxis *axisY = new QValueAxis();
-    axisY->setTitleText("Concentration");
-    axisY->setLabelFormat("%.2f");
-    axisY->setGridLineVisible(true);
-
-    // set range for Y axis
-    double margin = (maxY - minY) * 0.1;
-    if (margin == 0)
-        margin = maxY * 0.1;
-    axisY->setRange(std::max(0.0, minY - margin), maxY + margin);
-    axisY->setTickCount(5);
-
-    chart->addAxis(axisX, Qt::AlignBottom);
-    chart->addAxis(axisY, Qt::AlignLeft);
-
-    series->attachAxis(axisX);
-    series->attachAxis(axisY);
+    chartView->showSeries(series, pyramid, startTime, endTime, minY, maxY);
 
     // update info panel
     updateInfoPanel();
@@ -407,9 +321,9 @@ void POPsPage::updateInfoPanel()
     
     // get determinand.unit.label
     QString unit;
-    const auto& data = model->getPollutantData(selectedPollutant);
-    if (!data.empty()) {
-        unit = data[0].unit;
+    const auto rows = model->getPollutantRows(selectedPollutant);
+    if (!rows.empty()) {
+        unit = model->getDataset().unit(rows.front());
     }
     
     QString html = QString(
@@ -422,6 +336,9 @@ void POPsPage::updateInfoPanel()
         "<li>Average: %5 %9</li>"
         "<li>Maximum: %6 %9</li>"
         "<li>Minimum: %7 %9</li>"
+        "<li>Median (P50): %11 %9</li>"
+        "<li>90th percentile: %12 %9</li>"
+        "<li>95th percentile: %13 %9</li>"
         "<li>Sample Count: %8</li>"
         "</ul>"
         "<h4>Health and Environmental Information:</h4>"
@@ -436,7 +353,10 @@ void POPsPage::updateInfoPanel()
      .arg(QString::number(stats.minValue, 'f', 5))
      .arg(stats.sampleCount)
      .arg(unit)
-     .arg(getRiskInfo(selectedPollutant));
+     .arg(getRiskInfo(selectedPollutant))
+     .arg(QString::number(stats.percentile50, 'f', 5))
+     .arg(QString::number(stats.percentile90, 'f', 5))
+     .arg(QString::number(stats.percentile95, 'f', 5));
 
     infoPanel->setHtml(html);
 }
\ No newline at end of file
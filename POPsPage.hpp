@@ -3,9 +3,10 @@
 #include <QWidget>
 #include <QtCharts>
 #include "model.hpp"
+#include "RecomputeScheduler.hpp"
 
 class QComboBox;
-class QChartView;
+class ZoomableChartView;
 class QLabel;
 class QTextEdit;
 class QDateEdit; 
@@ -33,7 +34,6 @@ private:
     void createInfoPanel();
     QColor getComplianceColor(double value);
     QString getComplianceStatus(double value);
-    bool isPOP(const QString& determinandLabel, const QString& definition);
     QString getRiskInfo(const QString& pollutant);
 
     PollutantModel* model;
@@ -41,15 +41,20 @@ private:
     QComboBox* locationSelector;
     QDateEdit* startDateEdit;
     QDateEdit* endDateEdit;
-    QChartView* chartView;
+    ZoomableChartView* chartView;
     QLabel* tooltipLabel;
     QTextEdit* infoPanel;
+    // merges date and selection changes into one chart update
+    RecomputeScheduler* chartUpdate;
     
     struct Stats {
         double average;
         double maxValue;
         double minValue;
         int sampleCount;
+        double percentile50;
+        double percentile90;
+        double percentile95;
     };
     Stats calculateStats(const QString& pollutant, const QString& location);
 };
\ No newline at end of file
@@ -1,10 +1,12 @@
 #include "PollutantOverview.hpp"
 #include <QtWidgets>
+#include "ZoomableChartView.hpp"
 
 PollutantOverview::PollutantOverview(PollutantModel* dataModel, QWidget* parent)
     : QWidget(parent)
     , model(dataModel)
 {
+    chartUpdate = new RecomputeScheduler([this]() { updateChart(); }, this);
     setupUI();
     
     tooltipLabel = new QLabel(this);
@@ -94,7 +96,7 @@ void PollutantOverview::createPollutantSelector()
     pollutantSelector = new QComboBox();
     pollutantSelector->setMinimumWidth(150);
     connect(pollutantSelector, QOverload<const QString&>::of(&QComboBox::currentTextChanged),
-            this, &PollutantOverview::updateChart);
+            chartUpdate, &RecomputeScheduler::request);
 }
 
 void PollutantOverview::createChart()
@@ -103,7 +105,7 @@ void PollutantOverview::createChart()
     chart->setTitle("Pollutant Concentration Over Time");
     chart->setAnimationOptions(QChart::SeriesAnimations);
 
-    chartView = new QChartView(chart);
+    chartView = new ZoomableChartView(chart);
     chartView->setRenderHint(QPainter::Antialiasing);
     chartView->setMinimumHeight(400);
 }
@@ -165,7 +167,7 @@ void PollutantOverview::handleDateRangeChanged()
     if (startDateEdit->date() > endDateEdit->date()) {
         endDateEdit->setDate(startDateEdit->date().addDays(5));
     }
-    updateChart();
+    chartUpdate->request();
 }
 
 void PollutantOverview::updatePollutantList()
@@ -177,32 +179,10 @@ void PollutantOverview::updatePollutantList()
     
     pollutantSelector->clear();
 
-    QStringList keywords = {
-        "Lead", "Mercury", "Cadmium",
-        "Chromium", "Nitrate", "Phosphate",
-        "Chloroform", "1,1-Dichloro", "1,1,1,2 -TET",
-        "1,3 -DICHLOR", "1122TetClEth", "11Cl-PF3OUdS",
-        "11DClEthan", "12-DCA", "2,3,6-TBA",
-        "2,4-D", "2,4-Xylenol", "2,4,6-T",
-        "2,5-Xylenol", "245-T", "24Dichloropl",
-        "2Phenoxyprop", "3:3 FTCA", "4-CAA",
-        "4:2 FTSA", "4Cl3MePhenol", "4Phenoxbutyr",
-        "5:3 FTCA", "6:2 FTSA", "7:3 FTCA",
-        "8:2 FTSA", "9Cl-PF3ONS"
-    };
-
-    for (const auto &pollutant : model->uniquePollutants())
+    // metals, nutrients, solvents, PFAS and herbicides, as classified at load time
+    for (const auto &pollutant : model->pollutantsInCategories(OverviewCategories))
     {
-        QString label = pollutant.toLower();
-
-        for (const QString &keyword : keywords)
-        {
-            if (label.contains(keyword.toLower()))
-            {
-                pollutantSelector->addItem(pollutant);
-                break;
-            }
-        }
+        pollutantSelector->addItem(pollutant);
     }
 
 
@@ -218,7 +198,7 @@ void PollutantOverview::updatePollutantList()
         }
     }
     
-    updateChart();
+    chartUpdate->flush();
 }
 
 void PollutantOverview::updateChart()
@@ -234,80 +214,29 @@ void PollutantOverview::updateChart()
     connect(series, &QLineSeries::hovered,
             this, &PollutantOverview::handleHovered);
 
-    QDateTime startDate = startDateEdit->dateTime();
-    QDateTime endDate = endDateEdit->dateTime().addDays(1);
-
-    const auto& data = model->getPollutantData(selectedPollutant);
-    QMap<QDateTime, QPair<double, int>> dailyData;
-
-    double minY = std::numeric_limits<double>::max();
-    double maxY = std::numeric_limits<double>::lowest();
+    qint64 startTime = toSampleTime(startDateEdit->dateTime());
+    qint64 endTime = toSampleTime(endDateEdit->dateTime().addDays(1));
 
-    for (const auto& record : data) {
-        QDateTime recordTime = QDateTime::fromString(record.time, Qt::ISODate);
-        if (recordTime >= startDate && recordTime <= endDate) {
-            QPair<double, int>& dayData = dailyData[recordTime];
-            dayData.first += record.result;
-            dayData.second++;
+    int pollutantId = model->pollutantId(selectedPollutant);
+    std::shared_ptr<const SeriesPyramid> pyramid = model->getSeriesPyramid(pollutantId);
 
-            double value = record.result;
-            minY = std::min(minY, value);
-            maxY = std::max(maxY, value);
-        }
+    // the period covers whole days, so its totals come from the rollup cube
+    const RollupCube& cube = model->getDataset().rollupCube();
+    int firstSite, lastSite;
+    cube.pollutantSites(pollutantId, firstSite, lastSite);
+    RollupCell period;
+    for (int site = firstSite; site < lastSite; ++site) {
+        period.merge(cube.total(site, sampleDay(startTime), sampleDay(endTime)));
     }
-
-    double sum = 0;
-    int count = 0;
-    for (const auto& dayData : dailyData) {
-        sum += dayData.first;
-        count += dayData.second;
-    }
-    double periodAverage = count > 0 ? sum / count : 0;
+    double minY = period.min;
+    double maxY = period.max;
+    double periodAverage = period.mean();
 
     series->setPen(QPen(getComplianceColor(periodAverage), 2));
 
-    QVector<QDateTime> timePoints = dailyData.keys();
-    std::sort(timePoints.begin(), timePoints.end());
-
-    for (const QDateTime& time : timePoints) {
-        const QPair<double, int>& dayData = dailyData[time];
-        double average = dayData.first / dayData.second;
-        series->append(time.toMSecsSinceEpoch(), average);
-    }
+    chartView->showSeries(series, pyramid, startTime, endTime, minY, maxY);
 
     QChart* chart = chartView->chart();
-    chart->removeAllSeries();
-    
-    const auto oldAxes = chart->axes();
-    for (auto axis : oldAxes) {
-        chart->removeAxis(axis);
-    }
-
-    chart->addSeries(series);
-
-    QDateTimeAxis* axisX = new QDateTimeAxis();
-    axisX->setFormat("yyyy-MM-dd");
-    axisX->setTitleText("Date");
-    axisX->setGridLineVisible(true);
-    axisX->setLabelsAngle(-45);
-    axisX->setTickCount(8);
-
-    QValueAxis* axisY = new QValueAxis();
-    axisY->setTitleText("Concentration");
-    axisY->setLabelFormat("%.2f");
-    axisY->setGridLineVisible(true);
-
-    double yMargin = (maxY - minY) * 0.1;
-    if (yMargin == 0) yMargin = maxY * 0.1;
-    axisY->setRange(std::max(0.0, minY - yMargin), maxY + yMargin);
-    axisY->setTickCount(5);
-
-    chart->addAxis(axisX, Qt::AlignBottom);
-    chart->addAxis(axisY, Qt::AlignLeft);
-
-    series->attachAxis(axisX);
-    series->attachAxis(axisY);
-
     chart->setMargins(QMargins(10, 10, 10, 10));
     chart->legend()->setAlignment(Qt::AlignTop);
 }
\ No newline at end of file
@@ -3,10 +3,11 @@
 #include <QWidget>
 #include <QtCharts>
 #include "model.hpp"
+#include "RecomputeScheduler.hpp"
 
 class QComboBox;
 class QDateEdit;
-class QChartView;
+class ZoomableChartView;
 class QLineEdit;
 
 class PollutantOverview : public QWidget
@@ -36,7 +37,9 @@ private:
     QComboBox* pollutantSelector;
     QDateEdit* startDateEdit;
     QDateEdit* endDateEdit;
-    QChartView* chartView;
+    ZoomableChartView* chartView;
     QLabel* tooltipLabel;
     QLineEdit* searchBox;
+    // merges date and selection changes into one chart update
+    RecomputeScheduler* chartUpdate;
 };
\ No newline at end of file
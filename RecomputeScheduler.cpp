@@ -0,0 +1,25 @@
+#include "RecomputeScheduler.hpp"
+
+RecomputeScheduler::RecomputeScheduler(std::function<void()> callback, QObject *parent, int delay)
+    : QObject(parent), recompute(std::move(callback))
+{
+    timer.setSingleShot(true);
+    timer.setInterval(delay);
+    connect(&timer, &QTimer::timeout, this, [this]() { recompute(); });
+}
+
+void RecomputeScheduler::request()
+{
+    timer.start();
+}
+
+void RecomputeScheduler::flush()
+{
+    timer.stop();
+    recompute();
+}
+
+void RecomputeScheduler::cancel()
+{
+    timer.stop();
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <QObject>
+#include <QTimer>
+#include <functional>
+
+// Coalesces bursts of recompute requests from filter widgets. request()
+// restarts a short single-shot timer, so a run of date edits, arrow clicks
+// or combo box refills within the delay ends in one recompute; every
+// request but the newest is dropped. flush() runs a pending recompute now.
+class RecomputeScheduler : public QObject
+{
+    Q_OBJECT
+
+    public:
+        static constexpr int DefaultDelay = 200;   // milliseconds
+
+        explicit RecomputeScheduler(std::function<void()> recompute, QObject *parent = nullptr,
+                                    int delay = DefaultDelay);
+
+        void request();
+        void flush();
+        void cancel();
+        bool isPending() const { return timer.isActive(); }
+
+    private:
+        std::function<void()> recompute;
+        QTimer timer;
+};
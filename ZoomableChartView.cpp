@@ -0,0 +1,149 @@
+#include "ZoomableChartView.hpp"
+#include <algorithm>
+#include "downsample.hpp"
+#include "pyramid.hpp"
+
+ZoomableChartView::ZoomableChartView(QChart *chart, QWidget *parent)
+    : QChartView(chart, parent)
+{
+    setRubberBand(QChartView::HorizontalRubberBand);
+    connect(chart, &QChart::plotAreaChanged, this, &ZoomableChartView::updateSeriesPoints);
+}
+
+void ZoomableChartView::showSeries(QLineSeries *newSeries, std::shared_ptr<const SeriesPyramid> pyramid,
+                                   qint64 start, qint64 end, double minY, double maxY)
+{
+    QChart *chart = this->chart();
+    chart->removeAllSeries();
+    series = nullptr;
+    const auto oldAxes = chart->axes();
+    for (auto axis : oldAxes) {
+        chart->removeAxis(axis);
+    }
+
+    series = newSeries;
+    seriesPyramid = std::move(pyramid);
+    seriesStart = start;
+    seriesEnd = end;
+    chart->addSeries(series);
+
+    NodeRange samples = seriesPyramid->samples(start, end);
+    QDateTimeAxis *axisX = new QDateTimeAxis();
+    axisX->setFormat("yyyy-MM-dd");
+    axisX->setTitleText("Date");
+    axisX->setGridLineVisible(true);
+    axisX->setLabelsAngle(-45);
+    axisX->setTickCount(8);
+    if (!samples.empty()) {
+        axisX->setRange(sampleDateTime(samples.begin()->start), sampleDateTime((samples.end() - 1)->end));
+    }
+    connect(axisX, &QDateTimeAxis::rangeChanged, this, &ZoomableChartView::updateSeriesPoints);
+
+    QValueAxis *axisY = new QValueAxis();
+    axisY->setTitleText("Concentration");
+    axisY->setLabelFormat("%.2f");
+    axisY->setGridLineVisible(true);
+    double margin = (maxY - minY) * 0.1;
+    if (margin == 0)
+        margin = maxY * 0.1;
+    axisY->setRange(std::max(0.0, minY - margin), maxY + margin);
+    axisY->setTickCount(5);
+
+    chart->addAxis(axisX, Qt::AlignBottom);
+    chart->addAxis(axisY, Qt::AlignLeft);
+    series->attachAxis(axisX);
+    series->attachAxis(axisY);
+    updateSeriesPoints();
+}
+
+// Hands the series only what the plot can show: the pyramid level with
+// about one node per pixel over the part of the period in view, reduced to
+// at most a lowest and a highest point per pixel column. The axis ranges
+// are put back afterwards, since replacing the points may rescale them.
+void ZoomableChartView::updateSeriesPoints()
+{
+    QChart *chart = this->chart();
+    if (!series || !seriesPyramid || updatingSeries || chart->axes(Qt::Horizontal).isEmpty() || chart->axes(Qt::Vertical).isEmpty())
+        return;
+
+    QDateTimeAxis *axisX = qobject_cast<QDateTimeAxis *>(chart->axes(Qt::Horizontal).first());
+    QValueAxis *axisY = qobject_cast<QValueAxis *>(chart->axes(Qt::Vertical).first());
+    if (!axisX || !axisY)
+        return;
+
+    updatingSeries = true;
+    QDateTime minX = axisX->min();
+    QDateTime maxX = axisX->max();
+    double minY = axisY->min();
+    double maxY = axisY->max();
+
+    int width = (int)chart->plotArea().width();
+    qint64 viewStart = std::max(seriesStart, toSampleTime(minX));
+    qint64 viewEnd = std::min(seriesEnd, toSampleTime(maxX));
+    QList<QPointF> points = seriesPoints(seriesPyramid->query(viewStart, viewEnd, width));
+    series->replace(downsampleForPlot(points, minX.toMSecsSinceEpoch(), maxX.toMSecsSinceEpoch(), width));
+
+    axisX->setRange(minX, maxX);
+    axisY->setRange(minY, maxY);
+    updatingSeries = false;
+}
+
+// Zooms the x axis by a fixed step, keeping the time under the cursor in
+// place. The y axis is left alone.
+void ZoomableChartView::wheelEvent(QWheelEvent *event)
+{
+    if (event->angleDelta().y() == 0) {
+        QChartView::wheelEvent(event);
+        return;
+    }
+
+    double factor = event->angleDelta().y() > 0 ? 0.8 : 1.25;
+    QRectF plot = chart()->plotArea();
+    QPointF position = chart()->mapFromScene(mapToScene(event->position().toPoint()));
+    double x = std::clamp(position.x(), plot.left(), plot.right());
+
+    QRectF zoomed(x - (x - plot.left()) * factor, plot.top(), plot.width() * factor, plot.height());
+    chart()->zoomIn(zoomed);
+    event->accept();
+}
+
+void ZoomableChartView::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::MiddleButton) {
+        panning = true;
+        lastPanPosition = event->position();
+        setCursor(Qt::ClosedHandCursor);
+        event->accept();
+        return;
+    }
+    QChartView::mousePressEvent(event);
+}
+
+void ZoomableChartView::mouseMoveEvent(QMouseEvent *event)
+{
+    if (panning) {
+        QPointF delta = event->position() - lastPanPosition;
+        lastPanPosition = event->position();
+        chart()->scroll(-delta.x(), 0);
+        event->accept();
+        return;
+    }
+    QChartView::mouseMoveEvent(event);
+}
+
+void ZoomableChartView::mouseReleaseEvent(QMouseEvent *event)
+{
+    if (panning && event->button() == Qt::MiddleButton) {
+        panning = false;
+        unsetCursor();
+        event->accept();
+        return;
+    }
+    QChartView::mouseReleaseEvent(event);
+}
+
+void ZoomableChartView::mouseDoubleClickEvent(QMouseEvent *event)
+{
+    chart()->zoomReset();
+    event->accept();
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <memory>
+#include <QtCharts>
+
+class SeriesPyramid;
+
+// A chart view that zooms and pans along the time axis. Drag with the left
+// button to zoom into a period, turn the wheel to zoom around the cursor,
+// drag with the middle button to pan, and right-click or double-click to
+// zoom back out.
+//
+// The series it shows is drawn from a SeriesPyramid, at about the detail
+// the plot has pixels for, and redrawn whenever the plot is resized, zoomed
+// or panned.
+class ZoomableChartView : public QChartView
+{
+    Q_OBJECT
+
+    public:
+        explicit ZoomableChartView(QChart *chart, QWidget *parent = nullptr);
+
+        // Replaces the chart's series and axes with series, drawn from the
+        // part of pyramid sampled between start and end, against a date axis
+        // spanning those samples and a concentration axis from minY to maxY
+        // plus a margin. The view keeps the pyramid until the next call.
+        void showSeries(QLineSeries *series, std::shared_ptr<const SeriesPyramid> pyramid,
+                        qint64 start, qint64 end, double minY, double maxY);
+
+    protected:
+        void wheelEvent(QWheelEvent *event) override;
+        void mousePressEvent(QMouseEvent *event) override;
+        void mouseMoveEvent(QMouseEvent *event) override;
+        void mouseReleaseEvent(QMouseEvent *event) override;
+        void mouseDoubleClickEvent(QMouseEvent *event) override;
+
+    private slots:
+        void updateSeriesPoints();
+
+    private:
+        bool panning = false;
+        QPointF lastPanPosition;
+
+        std::shared_ptr<const SeriesPyramid> seriesPyramid;
+        qint64 seriesStart = 0;
+        qint64 seriesEnd = 0;
+        QLineSeries *series = nullptr;
+        bool updatingSeries = false;
+};
@@ -0,0 +1,262 @@
+#include "bitmap.hpp"
+#include <algorithm>
+#include <iterator>
+
+RowBitmap RowBitmap::fromSortedRows(const int* first, const int* last)
+{
+    RowBitmap bitmap;
+    while (first != last) {
+        Container container;
+        container.key = quint16(*first >> 16);
+        const int* end = std::find_if(first, last, [&](int row) { return (row >> 16) != container.key; });
+
+        container.values.reserve(end - first);
+        for (const int* row = first; row != end; ++row) {
+            container.values.push_back(quint16(*row & 0xFFFF));
+        }
+        container.cardinality = (int)container.values.size();
+        if (container.cardinality > ArrayLimit) {
+            toBitset(container);
+        }
+
+        bitmap.containers.push_back(std::move(container));
+        first = end;
+    }
+    return bitmap;
+}
+
+RowBitmap RowBitmap::range(int first, int last)
+{
+    RowBitmap bitmap;
+    for (int start = first; start < last; ) {
+        int end = std::min(last, ((start >> 16) + 1) << 16);
+
+        Container container;
+        container.key = quint16(start >> 16);
+        container.cardinality = end - start;
+        if (container.cardinality > ArrayLimit) {
+            std::vector<quint64> bits(BitsetWords, 0);
+            for (int row = start; row < end; ++row) {
+                bits[(row & 0xFFFF) >> 6] |= quint64(1) << (row & 63);
+            }
+            container.bits = Column<quint64>(std::move(bits));
+        } else {
+            for (int row = start; row < end; ++row) {
+                container.values.push_back(quint16(row & 0xFFFF));
+            }
+        }
+
+        bitmap.containers.push_back(std::move(container));
+        start = end;
+    }
+    return bitmap;
+}
+
+int RowBitmap::cardinality() const
+{
+    int total = 0;
+    for (const Container& container : containers) {
+        total += container.cardinality;
+    }
+    return total;
+}
+
+bool RowBitmap::contains(int row) const
+{
+    quint16 key = quint16(row >> 16);
+    quint16 low = quint16(row & 0xFFFF);
+    auto it = std::lower_bound(containers.begin(), containers.end(), key,
+                               [](const Container& container, quint16 k) { return container.key < k; });
+    if (it == containers.end() || it->key != key) {
+        return false;
+    }
+    if (it->isBitset()) {
+        return (it->bits[low >> 6] >> (low & 63)) & 1;
+    }
+    return std::binary_search(it->values.begin(), it->values.end(), low);
+}
+
+RowBitmap RowBitmap::operator&(const RowBitmap& other) const
+{
+    RowBitmap result;
+    auto a = containers.begin();
+    auto b = other.containers.begin();
+    while (a != containers.end() && b != other.containers.end()) {
+        if (a->key < b->key) {
+            ++a;
+        } else if (b->key < a->key) {
+            ++b;
+        } else {
+            Container container = intersect(*a, *b);
+            if (container.cardinality > 0) {
+                result.containers.push_back(std::move(container));
+            }
+            ++a;
+            ++b;
+        }
+    }
+    return result;
+}
+
+RowBitmap RowBitmap::operator|(const RowBitmap& other) const
+{
+    RowBitmap result;
+    auto a = containers.begin();
+    auto b = other.containers.begin();
+    while (a != containers.end() || b != other.containers.end()) {
+        if (b == other.containers.end() || (a != containers.end() && a->key < b->key)) {
+            result.containers.push_back(*a++);
+        } else if (a == containers.end() || b->key < a->key) {
+            result.containers.push_back(*b++);
+        } else {
+            result.containers.push_back(unite(*a++, *b++));
+        }
+    }
+    return result;
+}
+
+std::vector<int> RowBitmap::toRows() const
+{
+    std::vector<int> rows;
+    rows.reserve(cardinality());
+    forEach([&](int row) { rows.push_back(row); });
+    return rows;
+}
+
+RowBitmap::Container RowBitmap::intersect(const Container& a, const Container& b)
+{
+    Container result;
+    result.key = a.key;
+
+    if (a.isBitset() && b.isBitset()) {
+        std::vector<quint64> bits(BitsetWords);
+        for (int word = 0; word < BitsetWords; ++word) {
+            bits[word] = a.bits[word] & b.bits[word];
+            result.cardinality += qPopulationCount(bits[word]);
+        }
+        result.bits = Column<quint64>(std::move(bits));
+        if (result.cardinality <= ArrayLimit) {
+            toArray(result);
+        }
+    } else if (a.isBitset() || b.isBitset()) {
+        const Container& bitset = a.isBitset() ? a : b;
+        const Container& array = a.isBitset() ? b : a;
+        for (quint16 low : array.values) {
+            if ((bitset.bits[low >> 6] >> (low & 63)) & 1) {
+                result.values.push_back(low);
+            }
+        }
+        result.cardinality = (int)result.values.size();
+    } else {
+        std::set_intersection(a.values.begin(), a.values.end(),
+                              b.values.begin(), b.values.end(),
+                              std::back_inserter(result.values));
+        result.cardinality = (int)result.values.size();
+    }
+    return result;
+}
+
+RowBitmap::Container RowBitmap::unite(const Container& a, const Container& b)
+{
+    Container result;
+    result.key = a.key;
+
+    if (!a.isBitset() && !b.isBitset()) {
+        std::set_union(a.values.begin(), a.values.end(),
+                       b.values.begin(), b.values.end(),
+                       std::back_inserter(result.values));
+        result.cardinality = (int)result.values.size();
+        if (result.cardinality > ArrayLimit) {
+            toBitset(result);
+        }
+        return result;
+    }
+
+    std::vector<quint64> bits(BitsetWords, 0);
+    for (const Container* part : { &a, &b }) {
+        if (part->isBitset()) {
+            for (int word = 0; word < BitsetWords; ++word) {
+                bits[word] |= part->bits[word];
+            }
+        } else {
+            for (quint16 low : part->values) {
+                bits[low >> 6] |= quint64(1) << (low & 63);
+            }
+        }
+    }
+    for (quint64 word : bits) {
+        result.cardinality += qPopulationCount(word);
+    }
+    result.bits = Column<quint64>(std::move(bits));
+    return result;
+}
+
+void RowBitmap::toArray(Container& container)
+{
+    std::vector<quint16> values;
+    values.reserve(container.cardinality);
+    for (int word = 0; word < BitsetWords; ++word) {
+        quint64 bits = container.bits[word];
+        while (bits) {
+            values.push_back(quint16((word << 6) | int(qCountTrailingZeroBits(bits))));
+            bits &= bits - 1;
+        }
+    }
+    container.values = Column<quint16>(std::move(values));
+    container.bits = Column<quint64>();
+}
+
+void RowBitmap::toBitset(Container& container)
+{
+    std::vector<quint64> bits(BitsetWords, 0);
+    for (quint16 low : container.values) {
+        bits[low >> 6] |= quint64(1) << (low & 63);
+    }
+    container.bits = Column<quint64>(std::move(bits));
+    container.values = Column<quint16>();
+}
+
+void RowBitmap::save(std::vector<StoredContainer>& entries, std::vector<quint16>& lowBits,
+                     std::vector<quint64>& words) const
+{
+    for (const Container& container : containers) {
+        StoredContainer entry;
+        entry.key = container.key;
+        entry.isBitset = container.isBitset();
+        entry.cardinality = container.cardinality;
+        if (container.isBitset()) {
+            entry.offset = (qint64)words.size();
+            words.insert(words.end(), container.bits.begin(), container.bits.end());
+        } else {
+            entry.offset = (qint64)lowBits.size();
+            lowBits.insert(lowBits.end(), container.values.begin(), container.values.end());
+        }
+        entries.push_back(entry);
+    }
+}
+
+bool RowBitmap::map(const StoredContainer* entries, size_t count, const Column<quint16>& lowBits,
+                    const Column<quint64>& words)
+{
+    containers.clear();
+    containers.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        const StoredContainer& entry = entries[i];
+        Container& container = containers[i];
+        container.key = entry.key;
+        container.cardinality = entry.cardinality;
+        qint64 length = entry.isBitset ? BitsetWords : entry.cardinality;
+        qint64 available = entry.isBitset ? (qint64)words.size() : (qint64)lowBits.size();
+        if (entry.cardinality <= 0 || entry.cardinality > 65536 || entry.offset < 0 ||
+            entry.offset > available - length) {
+            containers.clear();
+            return false;
+        }
+        if (entry.isBitset) {
+            container.bits.map(words.data() + entry.offset, (size_t)length);
+        } else {
+            container.values.map(lowBits.data() + entry.offset, (size_t)length);
+        }
+    }
+    return true;
+}
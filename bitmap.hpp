@@ -0,0 +1,113 @@
+#pragma once
+
+#include <vector>
+#include <QtGlobal>
+#include <QtAlgorithms>
+#include "column.hpp"
+
+// A compressed set of row indices in the style of a Roaring bitmap. Rows
+// are split by their high 16 bits into containers. A container with few
+// rows keeps them as a sorted array of the low 16 bits and a dense one as
+// a 65536-bit bitset, so sparse and dense sets both stay small and can be
+// intersected or merged a container at a time.
+class RowBitmap
+{
+public:
+   RowBitmap() {}
+   static RowBitmap fromSortedRows(const int* first, const int* last);
+   static RowBitmap range(int first, int last);   // rows [first, last)
+
+   bool isEmpty() const { return containers.empty(); }
+   int cardinality() const;
+   bool contains(int row) const;
+
+   RowBitmap operator&(const RowBitmap& other) const;
+   RowBitmap operator|(const RowBitmap& other) const;
+   RowBitmap& operator&=(const RowBitmap& other) { return *this = *this & other; }
+   RowBitmap& operator|=(const RowBitmap& other) { return *this = *this | other; }
+
+   // calls visit(row) for every row in ascending order
+   template<typename Visitor>
+   void forEach(Visitor visit) const;
+   std::vector<int> toRows() const;
+
+   // visits the set a container at a time: bitset containers as
+   // visitBits(firstRow, words) with BitsetWords words, where bit i of word
+   // w stands for row firstRow + w * 64 + i, and array containers as
+   // visitArray(firstRow, lowBits, count)
+   template<typename BitsVisitor, typename ArrayVisitor>
+   void forEachBlock(BitsVisitor visitBits, ArrayVisitor visitArray) const;
+
+   static constexpr int BitsetWords = 1024;
+
+   // Snapshots keep bitmaps in three flat arrays: one entry per container,
+   // and the low bits of the array containers and the words of the bitset
+   // containers, each laid end to end. save() appends the bitmap to them;
+   // map() points the bitmap's containers at the values that
+   // entries[0 .. count) give, without copying any, and returns false,
+   // leaving the bitmap empty, if an entry reaches outside its array. The
+   // values must outlive the bitmap, as for Column::map().
+   struct StoredContainer {
+      quint16 key;
+      quint16 isBitset;
+      qint32 cardinality;
+      qint64 offset;   // into lowBits or words
+   };
+   void save(std::vector<StoredContainer>& entries, std::vector<quint16>& lowBits,
+             std::vector<quint64>& words) const;
+   bool map(const StoredContainer* entries, size_t count, const Column<quint16>& lowBits,
+            const Column<quint64>& words);
+
+private:
+   static constexpr int ArrayLimit = 4096;
+
+   struct Container {
+      quint16 key = 0;
+      int cardinality = 0;
+      Column<quint16> values;   // sorted low bits, for an array container
+      Column<quint64> bits;     // BitsetWords words, for a bitset container
+
+      bool isBitset() const { return !bits.empty(); }
+   };
+
+   static Container intersect(const Container& a, const Container& b);
+   static Container unite(const Container& a, const Container& b);
+   static void toArray(Container& container);
+   static void toBitset(Container& container);
+
+   std::vector<Container> containers;   // ascending by key, none empty
+};
+
+template<typename Visitor>
+void RowBitmap::forEach(Visitor visit) const
+{
+   for (const Container& container : containers) {
+      const int high = int(container.key) << 16;
+      if (container.isBitset()) {
+         for (int word = 0; word < BitsetWords; ++word) {
+            quint64 bits = container.bits[word];
+            while (bits) {
+               visit(high | (word << 6) | int(qCountTrailingZeroBits(bits)));
+               bits &= bits - 1;
+            }
+         }
+      } else {
+         for (quint16 low : container.values) {
+            visit(high | low);
+         }
+      }
+   }
+}
+
+template<typename BitsVisitor, typename ArrayVisitor>
+void RowBitmap::forEachBlock(BitsVisitor visitBits, ArrayVisitor visitArray) const
+{
+   for (const Container& container : containers) {
+      const int high = int(container.key) << 16;
+      if (container.isBitset()) {
+         visitBits(high, container.bits.data());
+      } else {
+         visitArray(high, container.values.data(), (int)container.values.size());
+      }
+   }
+}
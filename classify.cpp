@@ -0,0 +1,114 @@
+#include "classify.hpp"
+#include <queue>
+
+void KeywordMatcher::add(const QString& keyword, unsigned flags)
+{
+    if (next.empty()) {
+        next.assign(256, -1);
+        output.assign(1, 0);
+    }
+
+    int state = 0;
+    for (char c : keyword.toLower().toUtf8()) {
+        unsigned char byte = (unsigned char)c;
+        if (next[state * 256 + byte] < 0) {
+            next[state * 256 + byte] = (int)output.size();
+            next.resize(next.size() + 256, -1);
+            output.push_back(0);
+        }
+        state = next[state * 256 + byte];
+    }
+    output[state] |= flags;
+}
+
+// Breadth-first over the trie: a missing edge leads where the longest
+// proper suffix's state would go, and each state also reports the keywords
+// ending at its suffix link.
+void KeywordMatcher::build()
+{
+    if (next.empty()) {
+        next.assign(256, 0);
+        output.assign(1, 0);
+        return;
+    }
+
+    std::vector<int> link(output.size(), 0);
+    std::queue<int> pending;
+    for (int byte = 0; byte < 256; ++byte) {
+        int child = next[byte];
+        if (child < 0) {
+            next[byte] = 0;
+        } else {
+            link[child] = 0;
+            pending.push(child);
+        }
+    }
+
+    while (!pending.empty()) {
+        int state = pending.front();
+        pending.pop();
+        output[state] |= output[link[state]];
+
+        for (int byte = 0; byte < 256; ++byte) {
+            int child = next[state * 256 + byte];
+            int fallback = next[link[state] * 256 + byte];
+            if (child < 0) {
+                next[state * 256 + byte] = fallback;
+            } else {
+                link[child] = fallback;
+                pending.push(child);
+            }
+        }
+    }
+}
+
+unsigned KeywordMatcher::match(const QString& text) const
+{
+    unsigned flags = 0;
+    int state = 0;
+    for (char c : text.toLower().toUtf8()) {
+        state = transition(state, (unsigned char)c);
+        flags |= output[state];
+    }
+    return flags;
+}
+
+static KeywordMatcher buildPollutantMatcher()
+{
+    KeywordMatcher matcher;
+
+    for (const char* keyword : { "Lead", "Mercury", "Cadmium", "Chromium" }) {
+        matcher.add(keyword, Metal);
+    }
+    for (const char* keyword : { "Nitrate", "Phosphate" }) {
+        matcher.add(keyword, Nutrient);
+    }
+    for (const char* keyword : { "Chloroform", "1,1-Dichloro", "1,1,1,2 -TET", "1,3 -DICHLOR",
+                                 "1122TetClEth", "11DClEthan", "12-DCA" }) {
+        matcher.add(keyword, Solvent);
+    }
+    for (const char* keyword : { "11Cl-PF3OUdS", "3:3 FTCA", "4:2 FTSA", "5:3 FTCA", "6:2 FTSA",
+                                 "7:3 FTCA", "8:2 FTSA", "9Cl-PF3ONS" }) {
+        matcher.add(keyword, PFAS);
+    }
+    for (const char* keyword : { "2,3,6-TBA", "2,4-D", "2,4-Xylenol", "2,4,6-T", "2,5-Xylenol", "245-T",
+                                 "24Dichloropl", "2Phenoxyprop", "4-CAA", "4Cl3MePhenol", "4Phenoxbutyr" }) {
+        matcher.add(keyword, Herbicide);
+    }
+    for (const char* keyword : { "organic", "org", "carbon", "pcb", "dioxin", "furan",
+                                 "chlorinated", "pesticide", "herbicide", "pollutant" }) {
+        matcher.add(keyword, PersistentOrganic);
+    }
+    for (const char* keyword : { "BWP", "SewageDebris", "TarryResidus" }) {
+        matcher.add(keyword, Litter);
+    }
+
+    matcher.build();
+    return matcher;
+}
+
+unsigned classifyPollutant(const QString& label, const QString& definition)
+{
+    static const KeywordMatcher matcher = buildPollutantMatcher();
+    return matcher.match(label) | (matcher.match(definition) & PersistentOrganic);
+}
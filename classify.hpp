@@ -0,0 +1,43 @@
+#pragma once
+
+#include <vector>
+#include <QByteArray>
+#include <QString>
+
+// Categories a pollutant can belong to, as bit flags. They are assigned
+// from keywords in the pollutant's label; PersistentOrganic also looks at
+// its definition.
+enum PollutantCategory : unsigned {
+   Metal = 1u << 0,
+   Nutrient = 1u << 1,
+   Solvent = 1u << 2,
+   PFAS = 1u << 3,
+   Herbicide = 1u << 4,           // herbicides and related phenols
+   PersistentOrganic = 1u << 5,
+   Litter = 1u << 6,
+};
+
+// the categories shown by the pollutant overview
+constexpr unsigned OverviewCategories = Metal | Nutrient | Solvent | PFAS | Herbicide;
+
+// Finds every keyword that occurs in a text in a single pass over it
+// (Aho-Corasick), ignoring case. Each keyword carries flag bits and a
+// match reports the flags of all keywords found.
+class KeywordMatcher
+{
+public:
+   void add(const QString& keyword, unsigned flags);
+   // builds the automaton; call after the last add() and before match()
+   void build();
+   unsigned match(const QString& text) const;
+
+private:
+   int transition(int state, unsigned char byte) const { return next[state * 256 + byte]; }
+
+   // trie while adding, then a full transition table after build()
+   std::vector<int> next;
+   std::vector<unsigned> output;
+};
+
+// the PollutantCategory flags of a pollutant with this label and definition
+unsigned classifyPollutant(const QString& label, const QString& definition);
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// One column or index array of a PollutantDataset. While a CSV is parsed
+// the column owns its values in a vector; a dataset read from a snapshot
+// instead points it at the array inside the mapped file, so processes that
+// open the same snapshot share its pages. Either way it reads like a const
+// vector.
+template<typename T>
+class Column
+{
+public:
+   using value_type = T;
+
+   Column() {}
+   explicit Column(std::vector<T> owned): values(std::move(owned)) { reset(); }
+   Column(const Column& other): values(other.values) { adopt(other); }
+   Column(Column&& other) noexcept: values(std::move(other.values)) { adopt(other); other.reset(); }
+   Column& operator=(const Column& other)
+   {
+      if (this != &other) {
+         values = other.values;
+         adopt(other);
+      }
+      return *this;
+   }
+   Column& operator=(Column&& other) noexcept
+   {
+      if (this != &other) {
+         values = std::move(other.values);
+         adopt(other);
+         other.reset();
+      }
+      return *this;
+   }
+
+   size_t size() const { return count; }
+   bool empty() const { return count == 0; }
+   const T* data() const { return first; }
+   const T* begin() const { return first; }
+   const T* end() const { return first + count; }
+   const T& operator[](size_t i) const { return first[i]; }
+   const T& back() const { return first[count - 1]; }
+   const T& at(size_t i) const
+   {
+      if (i >= count) {
+         throw std::out_of_range("Column index out of range");
+      }
+      return first[i];
+   }
+
+   // whether the values live in a mapped snapshot rather than in the column
+   bool isMapped() const { return mapped; }
+
+   // filling an owned column
+   void reserve(size_t rows) { values.reserve(rows); }
+   T& back() { return values.back(); }
+   void push_back(const T& value)
+   {
+      values.push_back(value);
+      first = values.data();
+      count = values.size();
+   }
+   void append(const Column& other)
+   {
+      values.insert(values.end(), other.begin(), other.end());
+      first = values.data();
+      count = values.size();
+   }
+
+   // points the column at rows values owned by someone else, who must keep
+   // them alive and unchanged for as long as the column refers to them
+   void map(const T* data, size_t rows)
+   {
+      values = std::vector<T>();
+      first = data;
+      count = rows;
+      mapped = true;
+   }
+
+   void clear()
+   {
+      values.clear();
+      reset();
+   }
+
+private:
+   void adopt(const Column& other)
+   {
+      mapped = other.mapped;
+      first = mapped ? other.first : values.data();
+      count = other.count;
+   }
+
+   void reset()
+   {
+      first = values.data();
+      count = values.size();
+      mapped = false;
+   }
+
+   std::vector<T> values;
+   const T* first = nullptr;
+   size_t count = 0;
+   bool mapped = false;
+};
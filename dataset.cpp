@@ -1,65 +1,795 @@
 #include "dataset.hpp"
+#include "classify.hpp"
 #include "csv.hpp"
+#include "snapshot.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <istream>
+#include <streambuf>
+#include <thread>
+#include <QByteArray>
+#include <QFile>
+#include <QTimeZone>
 
-void PollutantDataset::loadData(const std::string& filename)
+// Reads a run of decimal digits, or returns -1 if any character is not one.
+static int parseDigits(const char* text, int count)
 {
-    csv::CSVReader reader(filename);
-    records.clear();
+    int value = 0;
+    for (int i = 0; i < count; ++i) {
+        unsigned digit = (unsigned)(text[i] - '0');
+        if (digit > 9) {
+            return -1;
+        }
+        value = value * 10 + (int)digit;
+    }
+    return value;
+}
 
-    for (auto& row : reader) {
-        try {
-            QString time = QString::fromStdString(row["sample.sampleDateTime"].get<>());
-            QString pollutant = QString::fromStdString(row["determinand.label"].get<>());
-            QString location = QString::fromStdString(row["sample.samplingPoint.label"].get<>());
-            QString definition = QString::fromStdString(row["determinand.definition"].get<>());
-            QString unit = QString::fromStdString(row["determinand.unit.label"].get<>());
-            QString type = QString::fromStdString(row["sample.sampledMaterialType.label"].get<>());
-            
-            // deal with the result field
-            double concentration = 0.0;
-            try {
-                concentration = row["result"].get<double>();
-            } catch (...) {
-                // if failed, try to get the string and convert
-                QString resultStr = QString::fromStdString(row["result"].get<std::string>());
-                if (resultStr.startsWith("<")) {
-                    // deal with small values
-                    resultStr = resultStr.mid(1);
-                    concentration = resultStr.toDouble();
-                } else {
-                    concentration = 0.0;  // default value
-                }
+// Days between 1970-01-01 and the given civil date (proleptic Gregorian).
+static qint64 daysFromCivil(int year, int month, int day)
+{
+    year -= month <= 2;
+    const int era = (year >= 0 ? year : year - 399) / 400;
+    const int yearOfEra = year - era * 400;
+    const int dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    const int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return (qint64)era * 146097 + dayOfEra - 719468;
+}
+
+qint64 parseSampleTime(const char* text, size_t length)
+{
+    // fast path for the archive's own YYYY-MM-DDThh:mm:ss layout
+    if ((length == 19 || (length == 20 && text[19] == 'Z')) &&
+        text[4] == '-' && text[7] == '-' && text[10] == 'T' &&
+        text[13] == ':' && text[16] == ':') {
+        int year = parseDigits(text, 4);
+        int month = parseDigits(text + 5, 2);
+        int day = parseDigits(text + 8, 2);
+        int hour = parseDigits(text + 11, 2);
+        int minute = parseDigits(text + 14, 2);
+        int second = parseDigits(text + 17, 2);
+
+        if (year >= 0 && month >= 1 && month <= 12 && day >= 1 &&
+            day <= QDate(year, month, 1).daysInMonth() &&
+            hour >= 0 && hour < 24 && minute >= 0 && minute < 60 &&
+            second >= 0 && second < 60) {
+            qint64 days = daysFromCivil(year, month, day);
+            return ((days * 24 + hour) * 60 + minute) * 60000 + second * 1000;
+        }
+        return InvalidSampleTime;
+    }
+
+    // anything else goes through Qt's ISO 8601 parser
+    QDateTime dateTime = QDateTime::fromString(QString::fromUtf8(text, (qsizetype)length), Qt::ISODate);
+    return dateTime.isValid() ? toSampleTime(dateTime) : InvalidSampleTime;
+}
+
+static bool isBlank(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+bool parseResult(const char* text, size_t length, double& value, ResultQualifier& qualifier)
+{
+    const char* first = text;
+    const char* last = text + length;
+    while (first != last && isBlank(*first)) ++first;
+    while (first != last && isBlank(last[-1])) --last;
+
+    qualifier = ExactResult;
+    if (first != last && (*first == '<' || *first == '>')) {
+        qualifier = *first == '<' ? BelowLimit : AboveLimit;
+        ++first;
+        while (first != last && isBlank(*first)) ++first;
+    }
+    if (first != last && *first == '+') {
+        ++first;
+    }
+
+    value = 0.0;
+    if (first == last) {
+        return false;
+    }
+#if defined(__cpp_lib_to_chars)
+    // from_chars also reads "nan" and "inf", which no result can be
+    auto parsed = std::from_chars(first, last, value);
+    if (parsed.ec == std::errc() && parsed.ptr == last && std::isfinite(value)) {
+        return true;
+    }
+    value = 0.0;
+    return false;
+#else
+    // standard libraries without floating-point from_chars
+    bool ok = false;
+    value = QByteArray::fromRawData(first, (qsizetype)(last - first)).toDouble(&ok);
+    if (!ok || !std::isfinite(value)) {
+        ok = false;
+        value = 0.0;
+    }
+    return ok;
+#endif
+}
+
+bool parseFlag(const char* text, size_t length)
+{
+    auto equals = [&](const char* word) {
+        size_t wordLength = std::strlen(word);
+        if (length != wordLength) {
+            return false;
+        }
+        for (size_t i = 0; i < length; ++i) {
+            if (std::tolower((unsigned char)text[i]) != word[i]) {
+                return false;
             }
+        }
+        return true;
+    };
+    return equals("true") || equals("1") || equals("yes");
+}
+
+qint64 toSampleTime(const QDateTime& dateTime)
+{
+    return QDateTime(dateTime.date(), dateTime.time(), QTimeZone::UTC).toMSecsSinceEpoch();
+}
+
+// Returns the sample's wall-clock time as a local QDateTime, which is how
+// the charts and date pickers present it.
+QDateTime sampleDateTime(qint64 time)
+{
+    QDateTime wallClock = QDateTime::fromMSecsSinceEpoch(time, QTimeZone::UTC);
+    return QDateTime(wallClock.date(), wallClock.time());
+}
+
+QString formatSampleTime(qint64 time)
+{
+    if (time == InvalidSampleTime) {
+        return QString();
+    }
+    return QDateTime::fromMSecsSinceEpoch(time, QTimeZone::UTC).toString("yyyy-MM-ddTHH:mm:ss");
+}
+
+// Returns the offset just past the record starting at begin, treating line
+// breaks inside quoted fields as part of the record.
+static size_t nextRecord(const char* data, size_t size, size_t begin, char quote)
+{
+    bool quoted = false;
+    for (size_t i = begin; i < size; ++i) {
+        if (data[i] == quote) {
+            quoted = !quoted;
+        } else if (data[i] == '\n' && !quoted) {
+            return i + 1;
+        }
+    }
+    return size;
+}
 
-            // deal with the compliance field
-            bool isCompliant = false;
+// Cuts [begin, size) into pieces of roughly chunkSize bytes which each end
+// on a record boundary. Only the quote parity is tracked between cuts, so
+// the scan runs at close to memory speed.
+static std::vector<size_t> splitRecords(const char* data, size_t size, size_t begin,
+                                        size_t chunkSize, char quote)
+{
+    std::vector<size_t> bounds{begin};
+    bool quoted = false;
+    size_t position = begin;
+
+    while (size - position > chunkSize) {
+        size_t target = position + chunkSize;
+        if (quote != '\0' && (std::count(data + position, data + target, quote) & 1)) {
+            quoted = !quoted;
+        }
+
+        position = size;
+        for (size_t i = target; i < size; ++i) {
+            if (data[i] == quote) {
+                quoted = !quoted;
+            } else if (data[i] == '\n' && !quoted) {
+                position = i + 1;
+                break;
+            }
+        }
+        bounds.push_back(position);
+    }
+
+    if (bounds.back() != size) {
+        bounds.push_back(size);
+    }
+    return bounds;
+}
+
+static std::vector<int> remapIds(StringDictionary& target, const StringDictionary& source)
+{
+    std::vector<int> ids(source.size());
+    for (int id = 0; id < source.size(); ++id) {
+        ids[id] = target.intern(source.value(id));
+    }
+    return ids;
+}
+
+void PollutantDataset::setThreadCount(int count)
+{
+    threadCount = std::max(0, count);
+}
+
+void PollutantDataset::setSnapshotsEnabled(bool enabled)
+{
+    snapshotsEnabled = enabled;
+}
+
+// A snapshot written next to the CSV on an earlier load is used instead of
+// parsing when it still matches the file; otherwise the CSV is parsed and a
+// fresh snapshot written. Snapshots are only a cache, so failing to write
+// one is not an error.
+void PollutantDataset::loadData(const std::string& filename, LoadControl* control)
+{
+    clear();
+
+    QString csvPath = QString::fromStdString(filename);
+    SnapshotStamp stamp;
+    if (snapshotsEnabled) {
+        stamp = stampSourceFile(csvPath);
+        if (readSnapshot(snapshotPath(csvPath), stamp)) {
+            if (control) {
+                control->bytesTotal = stamp.size;
+                control->bytesParsed = stamp.size;
+            }
+            return;
+        }
+        clear();
+    }
+
+    parseCsv(filename, control);
+    if (control && control->cancelled) {
+        return;
+    }
+
+    buildIndexes();
+    if (snapshotsEnabled) {
+        writeSnapshot(snapshotPath(csvPath), stamp);
+    }
+}
+
+// The file is memory-mapped and cut into chunks on record boundaries. Each
+// chunk is parsed by a worker into its own PollutantDataset, with its own
+// dictionaries, and the chunks are merged back in file order at the end.
+void PollutantDataset::parseCsv(const std::string& filename, LoadControl* control)
+{
+    // let csv.hpp detect the delimiter and read the header
+    csv::CSVFormat format;
+    std::vector<std::string> columnNames;
+    {
+        csv::CSVReader headerReader(filename);
+        format = headerReader.get_format();
+        columnNames = headerReader.get_col_names();
+    }
+
+    QFile file(QString::fromStdString(filename));
+    if (!file.open(QIODevice::ReadOnly)) {
+        throw std::runtime_error("Cannot open " + filename);
+    }
+    if (file.size() == 0) {
+        return;
+    }
+
+    // resolve every field's column once; this throws if any is missing
+    const SchemaBinding schema(columnNames, columnMap);
+
+    const uchar* mapping = file.map(0, file.size());
+    if (!mapping) {
+        throw std::runtime_error("Cannot map " + filename);
+    }
+
+    const char* data = reinterpret_cast<const char*>(mapping);
+    const size_t size = (size_t)file.size();
+    const char quote = format.is_quoting_enabled() ? format.get_quote_char() : '\0';
+
+    // skip the byte order mark and everything up to the end of the header row
+    size_t begin = size >= 3 && std::memcmp(data, "\xEF\xBB\xBF", 3) == 0 ? 3 : 0;
+    for (int i = 0; i <= format.get_header(); ++i) {
+        begin = nextRecord(data, size, begin, quote);
+    }
+    format.column_names(columnNames);
+
+    int workers = threadCount > 0 ? threadCount : (int)std::max(1u, std::thread::hardware_concurrency());
+
+    // several chunks per worker keeps the workers busy when chunks parse at
+    // different speeds, and bounds the text each worker holds at once
+    const size_t minChunk = 1 << 20;
+    const size_t maxChunk = csv::internals::ITERATION_CHUNK_SIZE;
+    size_t chunkSize = std::clamp((size - begin) / ((size_t)workers * 4), minChunk, maxChunk);
+    std::vector<size_t> bounds = splitRecords(data, size, begin, chunkSize, quote);
+
+    if (control) {
+        control->bytesTotal = (qint64)(size - begin);
+    }
+
+    const size_t chunkCount = bounds.size() - 1;
+    std::vector<PollutantDataset> chunks(chunkCount);
+    std::vector<std::exception_ptr> errors(chunkCount);
+    std::atomic<size_t> nextChunk{0};
+
+    auto work = [&]() {
+        for (size_t i = nextChunk++; i < chunkCount; i = nextChunk++) {
+            if (control && control->cancelled) {
+                return;
+            }
             try {
-                isCompliant = row["sample.isComplianceSample"].get<bool>();
+                chunks[i].loadRecords(data + bounds[i], bounds[i + 1] - bounds[i], format, schema);
             } catch (...) {
-                try {
-                    std::string complianceStr = row["sample.isComplianceSample"].get<std::string>();
-                    std::transform(complianceStr.begin(), complianceStr.end(), 
-                                 complianceStr.begin(), ::tolower);
-                    isCompliant = (complianceStr == "true" || complianceStr == "1" || 
-                                 complianceStr == "yes");
-                } catch (...) {
-                    isCompliant = false;
-                }
+                errors[i] = std::current_exception();
+            }
+            if (control) {
+                control->bytesParsed += (qint64)(bounds[i + 1] - bounds[i]);
             }
+        }
+    };
 
-            PollutantRecord record {
-                time,
-                pollutant,
-                concentration,
-                location,
-                definition,
-                unit,
-                type,
-                isCompliant
-            };
-            records.push_back(record);
+    workers = (int)std::min<size_t>(workers, chunkCount);
+    if (workers <= 1) {
+        work();
+    } else {
+        std::vector<std::thread> pool;
+        for (int i = 0; i < workers; ++i) {
+            pool.emplace_back(work);
+        }
+        for (auto& thread : pool) {
+            thread.join();
+        }
+    }
+
+    if (control && control->cancelled) {
+        return;
+    }
+
+    for (const auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    size_t rows = 0;
+    for (const auto& chunk : chunks) {
+        rows += chunk.resultColumn.size();
+    }
+    reserve(rows);
+
+    for (auto& chunk : chunks) {
+        append(chunk);
+        chunk = PollutantDataset();
+    }
+}
+
+// Read-only stream buffer over bytes that are already in memory, such as a
+// slice of the mapped CSV. Seeking is supported because the csv parser
+// measures its source by seeking to the end.
+class MemoryBuffer : public std::streambuf
+{
+public:
+    MemoryBuffer(const char* data, size_t length)
+    {
+        char* begin = const_cast<char*>(data);
+        setg(begin, begin, begin + length);
+    }
+
+protected:
+    pos_type seekoff(off_type offset, std::ios_base::seekdir direction, std::ios_base::openmode which) override
+    {
+        if (!(which & std::ios_base::in)) {
+            return pos_type(off_type(-1));
+        }
+        off_type position = offset;
+        if (direction == std::ios_base::cur) {
+            position += gptr() - eback();
+        } else if (direction == std::ios_base::end) {
+            position += egptr() - eback();
+        }
+        if (position < 0 || position > egptr() - eback()) {
+            return pos_type(off_type(-1));
+        }
+        setg(eback(), eback() + position, egptr());
+        return pos_type(position);
+    }
+
+    pos_type seekpos(pos_type position, std::ios_base::openmode which) override
+    {
+        return seekoff(off_type(position), std::ios_base::beg, which);
+    }
+};
+
+// The csv parser takes its stream by moving it, so the stream carries its
+// buffer along and points itself at the moved copy.
+class MemoryStream : public std::istream
+{
+public:
+    MemoryStream(const char* data, size_t length): std::istream(nullptr), buffer(data, length)
+    {
+        rdbuf(&buffer);
+    }
+
+    MemoryStream(MemoryStream&& other): std::istream(std::move(other)), buffer(std::move(other.buffer))
+    {
+        set_rdbuf(&buffer);
+    }
+
+private:
+    MemoryBuffer buffer;
+};
+
+void PollutantDataset::loadRecords(const char* data, size_t length, const csv::CSVFormat& format,
+                                   const SchemaBinding& schema)
+{
+    // the parser reads the slice where it lies, one block at a time, rather
+    // than from a copy of the whole slice
+    MemoryStream stream(data, length);
+    csv::CSVReader reader(stream, format);
+
+    for (auto& row : reader) {
+        // short records would throw on the first missing field
+        if ((int)row.size() < schema.minimumWidth()) {
+            continue;
+        }
+        try {
+            appendRow(row, schema);
         } catch (const std::exception& e) {
             continue;  // if exception occurs, skip this record
         }
     }
-}
\ No newline at end of file
+}
+
+// Fields are read by the positions the schema resolved from the header.
+void PollutantDataset::appendRow(csv::CSVRow& row, const SchemaBinding& schema)
+{
+    auto field = [&](SchemaField name) { return row[(size_t)schema.column(name)]; };
+
+    // text fields go into the dictionaries as the parser's own bytes, so
+    // only values not seen before allocate a QString
+    auto intern = [&](StringDictionary& dictionary, SchemaField name) {
+        csv::string_view text = field(name).get_sv();
+        return dictionary.intern(text.data(), text.size());
+    };
+
+    csv::string_view timeText = field(SampleTimeField).get_sv();
+    qint64 time = parseSampleTime(timeText.data(), timeText.size());
+    int pollutant = intern(pollutantNames, PollutantField);
+    int location = intern(locationNames, LocationField);
+    int definition = intern(definitionNames, DefinitionField);
+    int unit = intern(unitNames, UnitField);
+    int type = intern(typeNames, TypeField);
+    
+    // the result may carry a "<" or ">" detection-limit qualifier; an
+    // unreadable result is stored as 0
+    double concentration = 0.0;
+    ResultQualifier qualifier = ExactResult;
+    csv::string_view resultText = field(ResultField).get_sv();
+    parseResult(resultText.data(), resultText.size(), concentration, qualifier);
+    int notationColumn = schema.column(QualifierField);
+    if (qualifier == ExactResult && notationColumn >= 0 && notationColumn < (int)row.size()) {
+        // exports that give the qualifier in a column of its own
+        csv::string_view notation = row[(size_t)notationColumn].get_sv();
+        if (!notation.empty() && (notation[0] == '<' || notation[0] == '>')) {
+            qualifier = notation[0] == '<' ? BelowLimit : AboveLimit;
+        }
+    }
+
+    csv::string_view complianceText = field(ComplianceField).get_sv();
+    bool isCompliant = parseFlag(complianceText.data(), complianceText.size());
+
+    timeColumn.push_back(time);
+    pollutantColumn.push_back(pollutant);
+    resultColumn.push_back(concentration);
+    qualifierColumn.push_back(qualifier);
+    locationColumn.push_back(location);
+    definitionColumn.push_back(definition);
+    unitColumn.push_back(unit);
+    typeColumn.push_back(type);
+    complianceColumn.push_back(isCompliant);
+}
+
+void PollutantDataset::append(const PollutantDataset& chunk)
+{
+    std::vector<int> pollutantIds = remapIds(pollutantNames, chunk.pollutantNames);
+    std::vector<int> locationIds = remapIds(locationNames, chunk.locationNames);
+    std::vector<int> definitionIds = remapIds(definitionNames, chunk.definitionNames);
+    std::vector<int> unitIds = remapIds(unitNames, chunk.unitNames);
+    std::vector<int> typeIds = remapIds(typeNames, chunk.typeNames);
+
+    timeColumn.append(chunk.timeColumn);
+    resultColumn.append(chunk.resultColumn);
+    qualifierColumn.append(chunk.qualifierColumn);
+    complianceColumn.append(chunk.complianceColumn);
+
+    for (size_t i = 0; i < chunk.resultColumn.size(); ++i) {
+        pollutantColumn.push_back(pollutantIds[chunk.pollutantColumn[i]]);
+        locationColumn.push_back(locationIds[chunk.locationColumn[i]]);
+        definitionColumn.push_back(definitionIds[chunk.definitionColumn[i]]);
+        unitColumn.push_back(unitIds[chunk.unitColumn[i]]);
+        typeColumn.push_back(typeIds[chunk.typeColumn[i]]);
+    }
+}
+
+void PollutantDataset::reserve(size_t rows)
+{
+    timeColumn.reserve(rows);
+    pollutantColumn.reserve(rows);
+    resultColumn.reserve(rows);
+    qualifierColumn.reserve(rows);
+    locationColumn.reserve(rows);
+    definitionColumn.reserve(rows);
+    unitColumn.reserve(rows);
+    typeColumn.reserve(rows);
+    complianceColumn.reserve(rows);
+}
+
+PollutantRecord PollutantDataset::operator[](int index) const
+{
+    return PollutantRecord {
+        formatSampleTime(timeColumn.at(index)),
+        pollutantNames.value(pollutantColumn.at(index)),
+        resultColumn.at(index),
+        qualifierColumn.at(index),
+        locationNames.value(locationColumn.at(index)),
+        definitionNames.value(definitionColumn.at(index)),
+        unitNames.value(unitColumn.at(index)),
+        typeNames.value(typeColumn.at(index)),
+        complianceColumn.at(index) != 0
+    };
+}
+
+RowRange PollutantDataset::pollutantRows(int pollutantId) const
+{
+    if (pollutantId < 0 || pollutantId + 1 >= (int)pollutantRowStart.size()) {
+        return RowRange();
+    }
+    const int* rows = pollutantRowIndex.data();
+    return RowRange { rows + pollutantRowStart[pollutantId], rows + pollutantRowStart[pollutantId + 1] };
+}
+
+RowRange PollutantDataset::pollutantRowsByTime(int pollutantId) const
+{
+    if (pollutantId < 0 || pollutantId + 1 >= (int)pollutantRowStart.size()) {
+        return RowRange();
+    }
+    const int* rows = pollutantTimeIndex.data();
+    return RowRange { rows + pollutantRowStart[pollutantId], rows + pollutantRowStart[pollutantId + 1] };
+}
+
+static quint64 siteKey(int pollutantId, int locationId)
+{
+    return (quint64(quint32(pollutantId)) << 32) | quint32(locationId);
+}
+
+RowRange PollutantDataset::siteRowsByTime(int pollutantId, int locationId) const
+{
+    int site = rollups.findSite(pollutantId, locationId);
+    if (site < 0) {
+        return RowRange();
+    }
+    const int* rows = siteTimeIndex.data();
+    return RowRange { rows + siteStart[site], rows + siteStart[site + 1] };
+}
+
+RowRange PollutantDataset::timeSlice(RowRange rowsByTime, qint64 start, qint64 end) const
+{
+    start = std::max(start, InvalidSampleTime + 1);
+    const int* first = std::lower_bound(rowsByTime.begin(), rowsByTime.end(), start,
+                                        [this](int row, qint64 time) { return timeColumn[row] < time; });
+    const int* last = std::upper_bound(first, rowsByTime.end(), end,
+                                       [this](qint64 time, int row) { return time < timeColumn[row]; });
+    return RowRange { first, std::max(first, last) };
+}
+
+QuantileSketch PollutantDataset::resultSketch(int site, int firstDay, int endDay) const
+{
+    if (site < 0 || site >= rollups.siteCount()) {
+        return QuantileSketch();
+    }
+    const int* rows = siteTimeIndex.data();
+    RowRange siteRows { rows + siteStart[site], rows + siteStart[site + 1] };
+    return rollups.sketch(site, firstDay, endDay, [&](QuantileSketch& sketch, int first, int end) {
+        for (int row : timeSlice(siteRows, dayStartTime(first), dayStartTime(end) - 1)) {
+            sketch.add(resultColumn[row]);
+        }
+    });
+}
+
+static const RowBitmap& bitmapAt(const std::vector<RowBitmap>& bitmaps, int id)
+{
+    static const RowBitmap empty;
+    return id >= 0 && id < (int)bitmaps.size() ? bitmaps[id] : empty;
+}
+
+const RowBitmap& PollutantDataset::pollutantBitmap(int pollutantId) const
+{
+    return bitmapAt(pollutantBitmaps, pollutantId);
+}
+
+const RowBitmap& PollutantDataset::locationBitmap(int locationId) const
+{
+    return bitmapAt(locationBitmaps, locationId);
+}
+
+const RowBitmap& PollutantDataset::typeBitmap(int typeId) const
+{
+    return bitmapAt(typeBitmaps, typeId);
+}
+
+const RowBitmap& PollutantDataset::complianceRows(bool isComplianceSample) const
+{
+    return isComplianceSample ? complianceBitmap : nonComplianceBitmap;
+}
+
+// Counting sort of the row indices by the ids in a column: the rows holding
+// value v end up in index[start[v] .. start[v + 1]), ascending because rows
+// are scanned in order.
+template<typename Ids>
+static void groupRows(const Ids& column, int valueCount, std::vector<int>& start, std::vector<int>& index)
+{
+    start.assign(valueCount + 1, 0);
+    for (int id : column) {
+        start[id + 1]++;
+    }
+    for (size_t i = 1; i < start.size(); ++i) {
+        start[i] += start[i - 1];
+    }
+
+    index.resize(column.size());
+    std::vector<int> next(start.begin(), start.end() - 1);
+    for (int row = 0; row < (int)column.size(); ++row) {
+        index[next[column[row]]++] = row;
+    }
+}
+
+template<typename Offsets>
+static std::vector<RowBitmap> groupBitmaps(const Offsets& start, const Offsets& index)
+{
+    std::vector<RowBitmap> bitmaps;
+    bitmaps.reserve(start.size() - 1);
+    for (size_t id = 0; id + 1 < start.size(); ++id) {
+        bitmaps.push_back(RowBitmap::fromSortedRows(index.data() + start[id], index.data() + start[id + 1]));
+    }
+    return bitmaps;
+}
+
+static std::vector<CatalogEntry> buildCatalog(const StringDictionary& names, const Column<int>& column)
+{
+    std::vector<int> counts(names.size(), 0);
+    for (int id : column) {
+        counts[id]++;
+    }
+
+    std::vector<CatalogEntry> catalog;
+    catalog.reserve(names.size());
+    for (int id = 0; id < names.size(); ++id) {
+        if (counts[id] > 0) {
+            catalog.push_back(CatalogEntry { id, names.value(id), counts[id] });
+        }
+    }
+    std::sort(catalog.begin(), catalog.end(), [](const CatalogEntry& a, const CatalogEntry& b) {
+        return a.name < b.name;
+    });
+    return catalog;
+}
+
+// The row orders and the rollup cube, which snapshots save, and then the
+// lookups built from them.
+void PollutantDataset::buildIndexes()
+{
+    std::vector<int> start, index;
+    groupRows(pollutantColumn, pollutantNames.size(), start, index);
+
+    // Time orders are sorted within each pollutant's rows; stable sorts keep
+    // samples taken at the same time in file order.
+    std::vector<int> byTime = index;
+    std::vector<int> bySite = index;
+    for (size_t id = 0; id + 1 < start.size(); ++id) {
+        std::stable_sort(byTime.begin() + start[id], byTime.begin() + start[id + 1],
+                         [this](int a, int b) { return timeColumn[a] < timeColumn[b]; });
+        std::stable_sort(bySite.begin() + start[id], bySite.begin() + start[id + 1], [this](int a, int b) {
+            return locationColumn[a] != locationColumn[b] ? locationColumn[a] < locationColumn[b]
+                                                          : timeColumn[a] < timeColumn[b];
+        });
+    }
+
+    // each run of one (pollutant, location) in the site order becomes the
+    // next rollup site, so siteStart follows the cube's numbering
+    std::vector<int> siteFirst;
+    quint64 currentKey = 0;
+    rollups.clear();
+    for (int i = 0; i < (int)bySite.size(); ++i) {
+        int row = bySite[i];
+        quint64 key = siteKey(pollutantColumn[row], locationColumn[row]);
+        if (siteFirst.empty() || key != currentKey) {
+            currentKey = key;
+            siteFirst.push_back(i);
+            rollups.beginSite(pollutantColumn[row], locationColumn[row]);
+        }
+        rollups.add(timeColumn[row], resultColumn[row], complianceColumn[row]);
+    }
+    siteFirst.push_back((int)bySite.size());
+    rollups.finish();
+
+    pollutantRowStart = Column<int>(std::move(start));
+    pollutantRowIndex = Column<int>(std::move(index));
+    pollutantTimeIndex = Column<int>(std::move(byTime));
+    siteStart = Column<int>(std::move(siteFirst));
+    siteTimeIndex = Column<int>(std::move(bySite));
+
+    buildLookups();
+}
+
+// Catalogs, pollutant categories and bitmaps, the part of buildIndexes()
+// that reads the row orders. Snapshots save these too.
+void PollutantDataset::buildLookups()
+{
+    pollutantEntries = buildCatalog(pollutantNames, pollutantColumn);
+    locationEntries = buildCatalog(locationNames, locationColumn);
+    typeEntries = buildCatalog(typeNames, typeColumn);
+    unitEntries = buildCatalog(unitNames, unitColumn);
+
+    pollutantBitmaps = groupBitmaps(pollutantRowStart, pollutantRowIndex);
+
+    // each distinct pollutant is classified once, by its label and the
+    // definition on its first row
+    std::vector<unsigned> flags(pollutantNames.size(), 0);
+    for (int id = 0; id < pollutantNames.size(); ++id) {
+        RowRange rows = pollutantRows(id);
+        if (!rows.empty()) {
+            flags[id] = classifyPollutant(pollutantNames.value(id), definition(rows.front()));
+        }
+    }
+    pollutantCategoryFlags = Column<unsigned>(std::move(flags));
+
+    std::vector<int> start, index;
+    groupRows(locationColumn, locationNames.size(), start, index);
+    locationBitmaps = groupBitmaps(start, index);
+    groupRows(typeColumn, typeNames.size(), start, index);
+    typeBitmaps = groupBitmaps(start, index);
+
+    groupRows(complianceColumn, 2, start, index);
+    std::vector<RowBitmap> compliance = groupBitmaps(start, index);
+    nonComplianceBitmap = std::move(compliance[0]);
+    complianceBitmap = std::move(compliance[1]);
+}
+
+void PollutantDataset::clear()
+{
+    timeColumn.clear();
+    pollutantColumn.clear();
+    resultColumn.clear();
+    qualifierColumn.clear();
+    locationColumn.clear();
+    definitionColumn.clear();
+    unitColumn.clear();
+    typeColumn.clear();
+    complianceColumn.clear();
+    snapshotFile.reset();
+
+    pollutantNames.clear();
+    locationNames.clear();
+    definitionNames.clear();
+    unitNames.clear();
+    typeNames.clear();
+
+    pollutantEntries.clear();
+    locationEntries.clear();
+    typeEntries.clear();
+    unitEntries.clear();
+
+    pollutantRowStart.clear();
+    pollutantRowIndex.clear();
+    pollutantCategoryFlags.clear();
+    pollutantTimeIndex.clear();
+    siteStart.clear();
+    siteTimeIndex.clear();
+    rollups.clear();
+    pollutantBitmaps.clear();
+    locationBitmaps.clear();
+    typeBitmaps.clear();
+    complianceBitmap = RowBitmap();
+    nonComplianceBitmap = RowBitmap();
+}
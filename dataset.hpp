@@ -1,30 +1,243 @@
 #pragma once
 
+#include <atomic>
+#include <limits>
+#include <memory>
 #include <string>
 #include <vector>
+#include <QDateTime>
 #include <QString>
+#include "bitmap.hpp"
+#include "column.hpp"
+#include "dictionary.hpp"
+#include "rollup.hpp"
+#include "schema.hpp"
+
+namespace csv {
+   class CSVFormat;
+   class CSVRow;
+}
+
+class QFile;
+struct SnapshotStamp;
+
+// Sample times are stored as milliseconds since the epoch, taking the
+// archive's wall-clock time as if it were UTC. Date filters convert their
+// bounds with toSampleTime() and then only compare integers.
+constexpr qint64 InvalidSampleTime = std::numeric_limits<qint64>::min();
+
+qint64 parseSampleTime(const char* text, size_t length);
+
+// How a result relates to the value stored for it. Archives report values
+// below or above what a method can measure as "<0.1" or ">500"; the limit
+// is kept as the result and the qualifier says which side it was on.
+enum ResultQualifier : quint8 {
+   ExactResult,
+   BelowLimit,
+   AboveLimit
+};
+
+// Parse a result field without throwing: an optional '<' or '>' qualifier
+// and then a finite number. Anything else, "nan" and "inf" included, gives
+// 0 and returns false.
+bool parseResult(const char* text, size_t length, double& value, ResultQualifier& qualifier);
+// "true", "yes" and "1" in any case are true, anything else false.
+bool parseFlag(const char* text, size_t length);
+qint64 toSampleTime(const QDateTime& dateTime);
+QDateTime sampleDateTime(qint64 time);
+QString formatSampleTime(qint64 time);
+
+// Lets another thread follow a running loadData() and stop it. Progress
+// is counted in bytes of the CSV file handed to the parser so far.
+struct LoadControl {
+   std::atomic<qint64> bytesParsed{0};
+   std::atomic<qint64> bytesTotal{0};
+   std::atomic<bool> cancelled{false};
+};
+
+// A contiguous run of row indices owned by an index of the dataset, such as
+// the samples of one pollutant. Valid until the dataset is replaced.
+struct RowRange {
+   const int* first = nullptr;
+   const int* last = nullptr;
+
+   const int* begin() const { return first; }
+   const int* end() const { return last; }
+   int size() const { return (int)(last - first); }
+   bool empty() const { return first == last; }
+   int front() const { return *first; }
+   int operator[](int i) const { return first[i]; }
+};
+
+// One distinct value of a text column and how many rows hold it.
+struct CatalogEntry {
+   int id;
+   QString name;
+   int rowCount;
+};
 
 struct PollutantRecord {
    QString time;
    QString pollutant;
    double result;
+   ResultQualifier qualifier;
    QString location;
-   QString definition;  
-   QString unit;        
-   QString type;        
-   bool isComplianceSample; 
+   QString definition;
+   QString unit;
+   QString type;
+   bool isComplianceSample;
 };
 
+// Samples are stored column by column, so that a loop which only needs
+// the result and location of each sample does not have to pull whole
+// records through the cache. operator[] assembles a row view on demand.
+//
+// The text columns hold ids into per-column dictionaries which are filled
+// while loading; compare ids rather than strings when filtering.
 class PollutantDataset
 {
 public:
    PollutantDataset() {}
-   void loadData(const std::string& filename);
+   // if control is given and gets cancelled, loadData() returns early and
+   // leaves the dataset empty
+   void loadData(const std::string& filename, LoadControl* control = nullptr);
+
+   // number of worker threads used by loadData(); 0 means one per core
+   // and 1 parses the whole file on the calling thread
+   void setThreadCount(int count);
+
+   // whether loadData() reuses and writes binary snapshots (see snapshot.hpp)
+   void setSnapshotsEnabled(bool enabled);
+
+   // header names loadData() looks for; a CSV lacking any field makes it
+   // throw std::runtime_error
+   void setColumnMap(const ColumnMap& map) { columnMap = map; }
 
-   int size() const { return (int)records.size(); }
-   const PollutantRecord& operator[](int index) const { return records.at(index); }
-   const std::vector<PollutantRecord>& data() const { return records; }
+   int size() const { return (int)resultColumn.size(); }
+   PollutantRecord operator[](int index) const;
+
+   const Column<qint64>& times() const { return timeColumn; }
+   const Column<int>& pollutantIds() const { return pollutantColumn; }
+   const Column<double>& results() const { return resultColumn; }
+   const Column<ResultQualifier>& qualifiers() const { return qualifierColumn; }
+   const Column<int>& locationIds() const { return locationColumn; }
+   const Column<int>& definitionIds() const { return definitionColumn; }
+   const Column<int>& unitIds() const { return unitColumn; }
+   const Column<int>& typeIds() const { return typeColumn; }
+   const Column<quint8>& complianceFlags() const { return complianceColumn; }   // 0 or 1
+
+   const StringDictionary& pollutantDictionary() const { return pollutantNames; }
+   const StringDictionary& locationDictionary() const { return locationNames; }
+   const StringDictionary& definitionDictionary() const { return definitionNames; }
+   const StringDictionary& unitDictionary() const { return unitNames; }
+   const StringDictionary& typeDictionary() const { return typeNames; }
+
+   // the distinct values of a column sorted by name, built at load time
+   const std::vector<CatalogEntry>& pollutantCatalog() const { return pollutantEntries; }
+   const std::vector<CatalogEntry>& locationCatalog() const { return locationEntries; }
+   const std::vector<CatalogEntry>& typeCatalog() const { return typeEntries; }
+   const std::vector<CatalogEntry>& unitCatalog() const { return unitEntries; }
+
+   const QString& pollutant(int row) const { return pollutantNames.value(pollutantColumn[row]); }
+   const QString& location(int row) const { return locationNames.value(locationColumn[row]); }
+   const QString& definition(int row) const { return definitionNames.value(definitionColumn[row]); }
+   const QString& unit(int row) const { return unitNames.value(unitColumn[row]); }
+   const QString& type(int row) const { return typeNames.value(typeColumn[row]); }
+
+   // rows of one pollutant id in ascending order, from an index built at
+   // load time
+   RowRange pollutantRows(int pollutantId) const;
+
+   // PollutantCategory flags of a pollutant (see classify.hpp), assigned
+   // once at load time
+   unsigned pollutantCategories(int pollutantId) const { return pollutantCategoryFlags[pollutantId]; }
+
+   // compressed sets of the rows holding one value of a column, also built
+   // at load time; unknown ids give an empty set
+   const RowBitmap& pollutantBitmap(int pollutantId) const;
+   const RowBitmap& locationBitmap(int locationId) const;
+   const RowBitmap& typeBitmap(int typeId) const;
+   const RowBitmap& complianceRows(bool isComplianceSample) const;
+
+   // rows of one pollutant, or of one pollutant at one location, ordered by
+   // sample time (rows without a valid time come first)
+   RowRange pollutantRowsByTime(int pollutantId) const;
+   RowRange siteRowsByTime(int pollutantId, int locationId) const;
+   // the part of a time-ordered range sampled between start and end
+   // inclusive, found by binary search; rows without a valid time never match
+   RowRange timeSlice(RowRange rowsByTime, qint64 start, qint64 end) const;
+
+   // per-site totals by day, month and year, built at load time
+   const RollupCube& rollupCube() const { return rollups; }
+   // distribution of the results of a rollup site on days firstDay ..
+   // endDay - 1, from the cube's month and year sketches and the samples of
+   // the days at the edges; empty for a site out of range
+   QuantileSketch resultSketch(int site, int firstDay, int endDay) const;
 
 private:
-   std::vector<PollutantRecord> records;
+   void clear();
+   // builds every index, those of buildLookups() included; a snapshot holds
+   // all of them
+   void buildIndexes();
+   void buildLookups();
+   void reserve(size_t rows);
+   void parseCsv(const std::string& filename, LoadControl* control);
+   void loadRecords(const char* data, size_t length, const csv::CSVFormat& format, const SchemaBinding& schema);
+   void appendRow(csv::CSVRow& row, const SchemaBinding& schema);
+   void append(const PollutantDataset& chunk);
+
+   // implemented in snapshot.cpp
+   bool readSnapshot(const QString& path, const SnapshotStamp& stamp);
+   bool writeSnapshot(const QString& path, const SnapshotStamp& stamp) const;
+
+   int threadCount = 0;
+   bool snapshotsEnabled = true;
+   ColumnMap columnMap = ColumnMap::defaults();
+
+   Column<qint64> timeColumn;
+   Column<int> pollutantColumn;
+   Column<double> resultColumn;
+   Column<ResultQualifier> qualifierColumn;
+   Column<int> locationColumn;
+   Column<int> definitionColumn;
+   Column<int> unitColumn;
+   Column<int> typeColumn;
+   Column<quint8> complianceColumn;
+   // the mapped snapshot the columns, the indexes and the bitmaps point
+   // into, if they were read from one; shared by copies of the
+   // dataset and unmapped with the last of them
+   std::shared_ptr<QFile> snapshotFile;
+
+   StringDictionary pollutantNames;
+   StringDictionary locationNames;
+   StringDictionary definitionNames;
+   StringDictionary unitNames;
+   StringDictionary typeNames;
+
+   std::vector<CatalogEntry> pollutantEntries;
+   std::vector<CatalogEntry> locationEntries;
+   std::vector<CatalogEntry> typeEntries;
+   std::vector<CatalogEntry> unitEntries;
+
+   // rows grouped by pollutant id: the rows of pollutant p are
+   // pollutantRowIndex[pollutantRowStart[p] .. pollutantRowStart[p + 1])
+   Column<int> pollutantRowStart;
+   Column<int> pollutantRowIndex;
+   Column<unsigned> pollutantCategoryFlags;
+
+   // pollutantRowIndex reordered by time within each pollutant, sharing
+   // pollutantRowStart
+   Column<int> pollutantTimeIndex;
+   // rows ordered by pollutant, location and time; the rows of rollup site
+   // i are siteTimeIndex[siteStart[i] .. siteStart[i + 1]), so the cube's
+   // site numbering is the only one
+   Column<int> siteStart;
+   Column<int> siteTimeIndex;
+   RollupCube rollups;
+
+   std::vector<RowBitmap> pollutantBitmaps;
+   std::vector<RowBitmap> locationBitmaps;
+   std::vector<RowBitmap> typeBitmaps;
+   RowBitmap complianceBitmap;
+   RowBitmap nonComplianceBitmap;
 };
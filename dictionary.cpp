@@ -0,0 +1,45 @@
+#include "dictionary.hpp"
+
+int StringDictionary::intern(const QString& text)
+{
+    auto it = ids.constFind(text);
+    if (it != ids.constEnd()) {
+        return it.value();
+    }
+    return add(text, text.toUtf8());
+}
+
+int StringDictionary::intern(const char* utf8, size_t length)
+{
+    // a raw-data QByteArray wraps the buffer without copying it
+    auto it = utf8Ids.constFind(QByteArray::fromRawData(utf8, (qsizetype)length));
+    if (it != utf8Ids.constEnd()) {
+        return it.value();
+    }
+
+    // malformed input can decode to a value already held under other bytes
+    QByteArray bytes(utf8, (qsizetype)length);
+    QString text = QString::fromUtf8(bytes);
+    auto existing = ids.constFind(text);
+    if (existing != ids.constEnd()) {
+        utf8Ids.insert(bytes, existing.value());
+        return existing.value();
+    }
+    return add(text, bytes);
+}
+
+int StringDictionary::add(const QString& text, const QByteArray& utf8)
+{
+    int id = (int)values.size();
+    values.push_back(text);
+    ids.insert(text, id);
+    utf8Ids.insert(utf8, id);
+    return id;
+}
+
+void StringDictionary::clear()
+{
+    ids.clear();
+    utf8Ids.clear();
+    values.clear();
+}
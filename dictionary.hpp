@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vector>
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+
+// Maps each distinct value of a text column to a small integer id. Columns
+// with a few thousand distinct values over millions of rows then store and
+// compare ids, and each distinct string is held in memory only once.
+class StringDictionary
+{
+public:
+   static constexpr int NotFound = -1;
+
+   int intern(const QString& text);
+   // the same for UTF-8 text straight from a parser's buffer; the bytes are
+   // hashed as they are, and only a value not seen before is decoded and
+   // copied
+   int intern(const char* utf8, size_t length);
+   int find(const QString& text) const { return ids.value(text, NotFound); }
+
+   const QString& value(int id) const { return values[id]; }
+   const std::vector<QString>& entries() const { return values; }
+   int size() const { return (int)values.size(); }
+
+   void clear();
+
+private:
+   int add(const QString& text, const QByteArray& utf8);
+
+   QHash<QString, int> ids;
+   QHash<QByteArray, int> utf8Ids;
+   std::vector<QString> values;
+};
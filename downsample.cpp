@@ -0,0 +1,68 @@
+#include "downsample.hpp"
+#include <algorithm>
+#include <cmath>
+
+QList<QPointF> downsampleForPlot(const QList<QPointF>& points, double minX, double maxX, int width)
+{
+    auto first = std::lower_bound(points.begin(), points.end(), minX,
+                                  [](const QPointF& point, double x) { return point.x() < x; });
+    auto last = std::upper_bound(first, points.end(), maxX,
+                                 [](double x, const QPointF& point) { return x < point.x(); });
+    if (first != points.begin()) {
+        --first;
+    }
+    if (last != points.end()) {
+        ++last;
+    }
+
+    int buckets = std::max(width, 1);
+    if (last - first <= 2 * buckets || maxX <= minX) {
+        return QList<QPointF>(first, last);
+    }
+
+    // the points just outside the range fall into buckets -1 and buckets
+    double bucketWidth = (maxX - minX) / buckets;
+    auto bucketOf = [&](const QPointF& point) {
+        double bucket = std::floor((point.x() - minX) / bucketWidth);
+        return (int)std::clamp(bucket, -1.0, (double)buckets);
+    };
+
+    QList<QPointF> reduced;
+    reduced.reserve(2 * buckets + 4);
+    for (auto it = first; it != last; ) {
+        int bucket = bucketOf(*it);
+        auto low = it;
+        auto high = it;
+        for (++it; it != last && bucketOf(*it) == bucket; ++it) {
+            if (it->y() < low->y()) low = it;
+            if (it->y() > high->y()) high = it;
+        }
+
+        // keep the two in x order so the line is drawn left to right
+        reduced.append(*std::min(low, high));
+        if (low != high) {
+            reduced.append(*std::max(low, high));
+        }
+    }
+    return reduced;
+}
+
+QList<QPointF> seriesPoints(NodeRange nodes)
+{
+    QList<QPointF> points;
+    points.reserve(2 * nodes.size());
+    for (const SeriesNode& node : nodes) {
+        QPointF low(sampleDateTime(node.minTime).toMSecsSinceEpoch(), node.min);
+        QPointF high(sampleDateTime(node.maxTime).toMSecsSinceEpoch(), node.max);
+        if (node.minTime == node.maxTime) {
+            points.append(high);
+        } else if (node.minTime < node.maxTime) {
+            points.append(low);
+            points.append(high);
+        } else {
+            points.append(high);
+            points.append(low);
+        }
+    }
+    return points;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <QList>
+#include <QPointF>
+#include "pyramid.hpp"
+
+// Reduces a series sorted by x for drawing on a plot that is width pixels
+// wide and shows x from minX to maxX. Each pixel column keeps only its
+// lowest and highest point, so the line still reaches every peak and dip
+// that a full drawing would show. The nearest point on either side of the
+// range is kept too, so the line runs on to the plot's edges. A series
+// with no more than two points per pixel is returned unchanged.
+QList<QPointF> downsampleForPlot(const QList<QPointF>& points, double minX, double maxX, int width);
+
+// Chart points for pyramid nodes: the lowest and highest average of each
+// node at the times they were reached, in time order, with x in the
+// milliseconds of sampleDateTime() that the date axes use.
+QList<QPointF> seriesPoints(NodeRange nodes);
@@ -0,0 +1,196 @@
+#include "kernels.hpp"
+#include <algorithm>
+#include <limits>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define WQ_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+// Partial totals of one kernel call, merged into the caller's cell at the end.
+struct Partial {
+    int count = 0;
+    double sum = 0.0;
+    double sumSquares = 0.0;
+    double min = std::numeric_limits<double>::max();
+    double max = std::numeric_limits<double>::lowest();
+
+    void add(double value)
+    {
+        count++;
+        sum += value;
+        sumSquares += value * value;
+        min = std::min(min, value);
+        max = std::max(max, value);
+    }
+
+    void mergeInto(RollupCell& cell) const
+    {
+        if (count == 0) {
+            return;
+        }
+        cell.count += count;
+        cell.sum += sum;
+        cell.sumSquares += sumSquares;
+        cell.min = std::min(cell.min, min);
+        cell.max = std::max(cell.max, max);
+    }
+};
+
+static void addWordScalar(const double* values, quint64 bits, Partial& partial)
+{
+    while (bits) {
+        partial.add(values[qCountTrailingZeroBits(bits)]);
+        bits &= bits - 1;
+    }
+}
+
+static void maskedScalar(const double* values, const quint64* mask, int words, Partial& partial)
+{
+    for (int word = 0; word < words; ++word) {
+        addWordScalar(values + word * 64, mask[word], partial);
+    }
+}
+
+#ifdef WQ_X86_KERNELS
+
+// Unselected lanes are cleared for the sums and replaced by the identity
+// of min or max, so every lane can be combined without branches.
+
+#if defined(__x86_64__) || defined(__SSE2__)
+#define WQ_SSE2_BASELINE 1
+#endif
+
+__attribute__((target("sse2")))
+static void maskedSse2(const double* values, const quint64* mask, int words, Partial& partial)
+{
+    const __m128d lowest = _mm_set1_pd(std::numeric_limits<double>::lowest());
+    const __m128d highest = _mm_set1_pd(std::numeric_limits<double>::max());
+    __m128d sum = _mm_setzero_pd();
+    __m128d sumSquares = _mm_setzero_pd();
+    __m128d min = highest;
+    __m128d max = lowest;
+
+    for (int word = 0; word < words; ++word) {
+        quint64 bits = mask[word];
+        if (!bits) {
+            continue;
+        }
+        partial.count += qPopulationCount(bits);
+        const double* v = values + word * 64;
+        for (int i = 0; i < 64; i += 2) {
+            unsigned pair = unsigned(bits >> i) & 3;
+            if (!pair) {
+                continue;
+            }
+            __m128d x = _mm_loadu_pd(v + i);
+            __m128d m = _mm_castsi128_pd(_mm_set_epi64x(-qint64(pair >> 1), -qint64(pair & 1)));
+            __m128d picked = _mm_and_pd(x, m);
+            sum = _mm_add_pd(sum, picked);
+            sumSquares = _mm_add_pd(sumSquares, _mm_mul_pd(picked, picked));
+            min = _mm_min_pd(min, _mm_or_pd(picked, _mm_andnot_pd(m, highest)));
+            max = _mm_max_pd(max, _mm_or_pd(picked, _mm_andnot_pd(m, lowest)));
+        }
+    }
+
+    double lanes[2];
+    _mm_storeu_pd(lanes, sum);
+    partial.sum += lanes[0] + lanes[1];
+    _mm_storeu_pd(lanes, sumSquares);
+    partial.sumSquares += lanes[0] + lanes[1];
+    _mm_storeu_pd(lanes, min);
+    partial.min = std::min(partial.min, std::min(lanes[0], lanes[1]));
+    _mm_storeu_pd(lanes, max);
+    partial.max = std::max(partial.max, std::max(lanes[0], lanes[1]));
+}
+
+__attribute__((target("avx2")))
+static void maskedAvx2(const double* values, const quint64* mask, int words, Partial& partial)
+{
+    const __m256d lowest = _mm256_set1_pd(std::numeric_limits<double>::lowest());
+    const __m256d highest = _mm256_set1_pd(std::numeric_limits<double>::max());
+    const __m256i laneBits = _mm256_set_epi64x(8, 4, 2, 1);
+    __m256d sum = _mm256_setzero_pd();
+    __m256d sumSquares = _mm256_setzero_pd();
+    __m256d min = highest;
+    __m256d max = lowest;
+
+    for (int word = 0; word < words; ++word) {
+        quint64 bits = mask[word];
+        if (!bits) {
+            continue;
+        }
+        partial.count += qPopulationCount(bits);
+        const double* v = values + word * 64;
+        for (int i = 0; i < 64; i += 4) {
+            qint64 nibble = qint64(bits >> i) & 15;
+            if (!nibble) {
+                continue;
+            }
+            __m256d x = _mm256_loadu_pd(v + i);
+            __m256i selected = _mm256_and_si256(_mm256_set1_epi64x(nibble), laneBits);
+            __m256d m = _mm256_castsi256_pd(_mm256_cmpeq_epi64(selected, laneBits));
+            __m256d picked = _mm256_and_pd(x, m);
+            sum = _mm256_add_pd(sum, picked);
+            sumSquares = _mm256_add_pd(sumSquares, _mm256_mul_pd(picked, picked));
+            min = _mm256_min_pd(min, _mm256_blendv_pd(highest, x, m));
+            max = _mm256_max_pd(max, _mm256_blendv_pd(lowest, x, m));
+        }
+    }
+
+    double lanes[4];
+    _mm256_storeu_pd(lanes, sum);
+    partial.sum += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    _mm256_storeu_pd(lanes, sumSquares);
+    partial.sumSquares += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    _mm256_storeu_pd(lanes, min);
+    partial.min = std::min({ partial.min, lanes[0], lanes[1], lanes[2], lanes[3] });
+    _mm256_storeu_pd(lanes, max);
+    partial.max = std::max({ partial.max, lanes[0], lanes[1], lanes[2], lanes[3] });
+}
+
+#endif
+
+using MaskedKernel = void (*)(const double*, const quint64*, int, Partial&);
+
+static MaskedKernel chooseKernel()
+{
+#ifdef WQ_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return maskedAvx2;
+    }
+#ifdef WQ_SSE2_BASELINE
+    return maskedSse2;
+#else
+    if (__builtin_cpu_supports("sse2")) {
+        return maskedSse2;
+    }
+#endif
+#endif
+    return maskedScalar;
+}
+
+void summarizeMasked(const double* values, const quint64* mask, int count, RollupCell& cell)
+{
+    Partial partial;
+    // the vector kernels load whole words of values, so a partly backed
+    // last word is finished here
+    static const MaskedKernel kernel = chooseKernel();
+    int words = count / 64;
+    kernel(values, mask, words, partial);
+    if (count % 64) {
+        quint64 tail = mask[words] & ((quint64(1) << (count % 64)) - 1);
+        addWordScalar(values + words * 64, tail, partial);
+    }
+    partial.mergeInto(cell);
+}
+
+void summarizeIndexed(const double* values, const quint16* offsets, int count, RollupCell& cell)
+{
+    Partial partial;
+    for (int i = 0; i < count; ++i) {
+        partial.add(values[offsets[i]]);
+    }
+    partial.mergeInto(cell);
+}
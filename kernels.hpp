@@ -0,0 +1,17 @@
+#pragma once
+
+#include <QtGlobal>
+#include "rollup.hpp"
+
+// Totals over a result column for the rows picked by a selection mask, as
+// used by PollutantModel::summarizeRows(). The masked kernel has AVX2 and
+// SSE2 versions on x86, chosen once at runtime from what the CPU supports,
+// and a scalar version elsewhere. Only count, sum, sumSquares, min and max
+// of the cell are updated.
+
+// Adds values[i] for each i < count whose bit is set in mask, where bit i
+// is bit i % 64 of mask[i / 64]. Nothing at or past values + count is read.
+void summarizeMasked(const double* values, const quint64* mask, int count, RollupCell& cell);
+
+// Adds values[offsets[i]] for each i < count.
+void summarizeIndexed(const double* values, const quint16* offsets, int count, RollupCell& cell);
@@ -1,12 +1,21 @@
 #include "model.hpp"
+#include "kernels.hpp"
+#include <algorithm>
 
 void PollutantModel::updateFromFile(const QString& filename)
+{
+    PollutantDataset loaded;
+    loaded.loadData(filename.toStdString());
+    setDataset(std::move(loaded));
+}
+
+void PollutantModel::setDataset(PollutantDataset&& loaded)
 {
     beginResetModel();
-    dataset.loadData(filename.toStdString());
+    dataset = std::move(loaded);
+    pyramids.clear();
+    selectRows();
     endResetModel();
-
-    applyFilter();
 }
 
 QVariant PollutantModel::data(const QModelIndex& index, int role) const
@@ -16,12 +25,20 @@ QVariant PollutantModel::data(const QModelIndex& index, int role) const
     }
 
     if (role == Qt::DisplayRole) {
-        const auto& record = filteredData.at(index.row());
+        int row = showingAll ? index.row() : filteredRows[index.row()];
         switch (index.column()) {
-            case 0: return record.time; 
-            case 1: return record.pollutant; 
-            case 2: return record.result;   // concentration value
-            case 3: return record.location; 
+            case 0: return formatSampleTime(dataset.times()[row]);
+            case 1: return dataset.pollutant(row);
+            case 2: {
+                // concentration value, with its detection-limit qualifier
+                double result = dataset.results()[row];
+                switch (dataset.qualifiers()[row]) {
+                    case BelowLimit: return QString("<%1").arg(result);
+                    case AboveLimit: return QString(">%1").arg(result);
+                    default: return result;
+                }
+            }
+            case 3: return dataset.location(row);
         }
     }
 
@@ -31,45 +48,127 @@ QVariant PollutantModel::data(const QModelIndex& index, int role) const
 void PollutantModel::applyFilter()
 {
     beginResetModel();
-    filteredData.clear();
-    for (const auto& r: dataset.data()) {
-        if (currentFilter == "All" || r.pollutant == currentFilter) {
-            filteredData.push_back(r);
-        }
-    }
+    selectRows();
     endResetModel();
 }
 
+// "All" shows the dataset as it is; any other filter shows the pollutant's
+// rows straight out of the dataset's index, so nothing is copied.
+void PollutantModel::selectRows()
+{
+    showingAll = currentFilter == "All";
+    filteredRows = showingAll ? RowRange() : getPollutantRows(currentFilter);
+}
+
 void PollutantModel::setFilterPollutant(const QString& pollutant)
 {
     currentFilter = pollutant;
     applyFilter();
 }
 
-std::vector<QString> PollutantModel::uniquePollutants() const
+// Each constrained column becomes the union of its values' bitmaps; the
+// smallest of those is intersected with the rest first so that the
+// intermediate sets shrink as quickly as possible.
+RowBitmap PollutantModel::queryRows(const RowQuery& query) const
+{
+    auto unite = [](const std::vector<int>& ids, auto lookup) {
+        RowBitmap rows = lookup(ids.front());
+        for (size_t i = 1; i < ids.size(); ++i) {
+            rows |= lookup(ids[i]);
+        }
+        return rows;
+    };
+
+    std::vector<RowBitmap> terms;
+    if (!query.pollutantIds.empty()) {
+        terms.push_back(unite(query.pollutantIds, [this](int id) -> const RowBitmap& { return dataset.pollutantBitmap(id); }));
+    }
+    if (!query.locationIds.empty()) {
+        terms.push_back(unite(query.locationIds, [this](int id) -> const RowBitmap& { return dataset.locationBitmap(id); }));
+    }
+    if (!query.typeIds.empty()) {
+        terms.push_back(unite(query.typeIds, [this](int id) -> const RowBitmap& { return dataset.typeBitmap(id); }));
+    }
+    if (query.compliance != RowQuery::AnyCompliance) {
+        terms.push_back(dataset.complianceRows(query.compliance == RowQuery::ComplianceOnly));
+    }
+
+    if (terms.empty()) {
+        return RowBitmap::range(0, dataset.size());
+    }
+
+    std::sort(terms.begin(), terms.end(), [](const RowBitmap& a, const RowBitmap& b) {
+        return a.cardinality() < b.cardinality();
+    });
+    RowBitmap rows = terms.front();
+    for (size_t i = 1; i < terms.size() && !rows.isEmpty(); ++i) {
+        rows &= terms[i];
+    }
+    return rows;
+}
+
+RollupCell PollutantModel::summarizeRows(const RowBitmap& rows) const
 {
-    std::set<QString> unique;
-    for (auto& r: dataset.data()) {
-        unique.insert(r.pollutant);
+    const double* results = dataset.results().data();
+    const int rowCount = dataset.size();
+
+    // dense containers go through the masked kernel a 64-row word at a
+    // time; sparse ones are gathered
+    RollupCell cell;
+    rows.forEachBlock(
+        [&](int firstRow, const quint64* words) {
+            int count = std::min(rowCount - firstRow, RowBitmap::BitsetWords * 64);
+            summarizeMasked(results + firstRow, words, count, cell);
+        },
+        [&](int firstRow, const quint16* lowBits, int count) {
+            summarizeIndexed(results + firstRow, lowBits, count, cell);
+        });
+    cell.complianceCount = (rows & dataset.complianceRows(true)).cardinality();
+    return cell;
+}
+
+std::shared_ptr<const SeriesPyramid> PollutantModel::getSeriesPyramid(int pollutantId, int locationId) const
+{
+    quint64 key = (quint64(quint32(pollutantId)) << 32) | quint32(locationId);
+    auto it = std::find_if(pyramids.begin(), pyramids.end(), [key](const auto& entry) { return entry.first == key; });
+    if (it != pyramids.end()) {
+        std::rotate(pyramids.begin(), it, it + 1);
+        return pyramids.front().second;
+    }
+
+    RowRange rows = locationId == AllLocations ? dataset.pollutantRowsByTime(pollutantId)
+                                               : dataset.siteRowsByTime(pollutantId, locationId);
+    auto pyramid = std::make_shared<const SeriesPyramid>(dataset, rows);
+    if (pyramids.size() == CachedPyramids) {
+        pyramids.pop_back();
     }
-    return std::vector<QString>(unique.begin(), unique.end());
+    pyramids.emplace(pyramids.begin(), key, pyramid);
+    return pyramid;
 }
 
-std::vector<QString> PollutantModel::uniqueTypes() const
+std::vector<QString> PollutantModel::catalogNames(const std::vector<CatalogEntry>& catalog)
 {
-    std::set<QString> unique;
-    for (auto& r: dataset.data()) {
-        unique.insert(r.type);
+    std::vector<QString> names;
+    names.reserve(catalog.size());
+    for (const CatalogEntry& entry : catalog) {
+        names.push_back(entry.name);
     }
-    return std::vector<QString>(unique.begin(), unique.end());
+    return names;
 }
 
-QString PollutantModel::getPollutantDefinition(const QString& pollutant) const
+std::vector<QString> PollutantModel::pollutantsInCategories(unsigned categories) const
 {
-    for (const auto& record : dataset.data()) {
-        if (record.pollutant == pollutant) {
-            return record.definition;  
+    std::vector<QString> pollutants;
+    for (const CatalogEntry& entry : dataset.pollutantCatalog()) {
+        if (dataset.pollutantCategories(entry.id) & categories) {
+            pollutants.push_back(entry.name);
         }
     }
-    return QString();
+    return pollutants;
+}
+
+QString PollutantModel::getPollutantDefinition(const QString& pollutant) const
+{
+    RowRange rows = getPollutantRows(pollutant);
+    return rows.empty() ? QString() : dataset.definition(rows.front());
 }
@@ -2,9 +2,24 @@
 
 #include <QAbstractTableModel>
 #include <QString>
+#include <memory>
+#include <utility>
 #include <vector>
-#include <set>
 #include "dataset.hpp"
+#include "classify.hpp"
+#include "pyramid.hpp"
+
+// Describes a set of rows by column values. The ids listed for one column
+// are ORed together and the columns that list any ids are ANDed, so an
+// empty query matches every row.
+struct RowQuery {
+   enum Compliance { AnyCompliance, ComplianceOnly, NonComplianceOnly };
+
+   std::vector<int> pollutantIds;
+   std::vector<int> locationIds;
+   std::vector<int> typeIds;
+   Compliance compliance = AnyCompliance;
+};
 
 class PollutantModel: public QAbstractTableModel
 {
@@ -13,34 +28,72 @@ class PollutantModel: public QAbstractTableModel
 public:
    PollutantModel(QObject* parent = nullptr): QAbstractTableModel(parent) {}
    void updateFromFile(const QString&);
+   // replaces the current data in one step, e.g. with a dataset loaded in
+   // the background
+   void setDataset(PollutantDataset&& loaded);
    bool hasData() const { return dataset.size() > 0; }
 
-   int rowCount(const QModelIndex&) const override { return (int)filteredData.size(); }
+   int rowCount(const QModelIndex&) const override { return showingAll ? dataset.size() : filteredRows.size(); }
    int columnCount(const QModelIndex&) const override { return 4; }
 
    QVariant data(const QModelIndex&, int) const override;
 
    void setFilterPollutant(const QString& pollutant);
-   std::vector<QString> uniquePollutants() const;
-   std::vector<QString> uniqueTypes() const;
+   // distinct values in name order, read from the dataset's catalogs
+   std::vector<QString> uniquePollutants() const { return catalogNames(dataset.pollutantCatalog()); }
+   std::vector<QString> uniqueLocations() const { return catalogNames(dataset.locationCatalog()); }
+   std::vector<QString> uniqueTypes() const { return catalogNames(dataset.typeCatalog()); }
+   std::vector<QString> uniqueUnits() const { return catalogNames(dataset.unitCatalog()); }
+
+   // the catalogs themselves, with the row count of each value
+   const std::vector<CatalogEntry>& pollutantCatalog() const { return dataset.pollutantCatalog(); }
+   const std::vector<CatalogEntry>& locationCatalog() const { return dataset.locationCatalog(); }
+   const std::vector<CatalogEntry>& typeCatalog() const { return dataset.typeCatalog(); }
+   const std::vector<CatalogEntry>& unitCatalog() const { return dataset.unitCatalog(); }
+   // names of the pollutants with any of the given PollutantCategory
+   // flags, sorted
+   std::vector<QString> pollutantsInCategories(unsigned categories) const;
    
-   std::vector<PollutantRecord> getPollutantData(const QString& pollutant) const {
-       std::vector<PollutantRecord> result;
-       for (const auto& record : dataset.data()) {
-           if (pollutant.isEmpty() || record.pollutant == pollutant) {
-               result.push_back(record);
-           }
-       }
-       return result;
-   }
+   // dictionary ids of column values, or StringDictionary::NotFound;
+   // filters compare these instead of the strings
+   int pollutantId(const QString& pollutant) const { return dataset.pollutantDictionary().find(pollutant); }
+   int locationId(const QString& location) const { return dataset.locationDictionary().find(location); }
+   int typeId(const QString& type) const { return dataset.typeDictionary().find(type); }
+
+   // row indices into getDataset() of the samples of one pollutant, read
+   // from the dataset's index without copying
+   RowRange getPollutantRows(const QString& pollutant) const { return getPollutantRows(pollutantId(pollutant)); }
+   RowRange getPollutantRows(int pollutantId) const { return dataset.pollutantRows(pollutantId); }
+
+   // rows matching a query, combined from the dataset's bitmap indexes
+   RowBitmap queryRows(const RowQuery& query) const;
+   // count, sum, sum of squares, range and compliance samples of the
+   // results of a set of rows, computed with the kernels in kernels.hpp
+   RollupCell summarizeRows(const RowBitmap& rows) const;
+   RollupCell summarizeRows(const RowQuery& query) const { return summarizeRows(queryRows(query)); }
+
+   // min/max/mean pyramid of a pollutant's per-time averages at one
+   // location, or at every location for AllLocations; built on first use
+   // and kept while it is among the last few used, until the dataset is
+   // replaced
+   static constexpr int AllLocations = -2;
+   std::shared_ptr<const SeriesPyramid> getSeriesPyramid(int pollutantId, int locationId = AllLocations) const;
    
    QString getPollutantDefinition(const QString& pollutant) const;
-   const std::vector<PollutantRecord>& getAllData() const { return dataset.data(); }
+   const PollutantDataset& getDataset() const { return dataset; }
 
 private:
    PollutantDataset dataset;
-   std::vector<PollutantRecord> filteredData; 
+   // rows of dataset shown by the table, unless showingAll
+   RowRange filteredRows;
+   bool showingAll = true;
    QString currentFilter = "All";
+   // pyramids by (pollutant id << 32 | location id), most recently used
+   // first; charts switch between a few selections, so only those are kept
+   static constexpr size_t CachedPyramids = 8;
+   mutable std::vector<std::pair<quint64, std::shared_ptr<const SeriesPyramid>>> pyramids;
 
+   static std::vector<QString> catalogNames(const std::vector<CatalogEntry>& catalog);
    void applyFilter();
+   void selectRows();
 };
@@ -0,0 +1,73 @@
+#include "pyramid.hpp"
+#include <algorithm>
+
+SeriesPyramid::SeriesPyramid(const PollutantDataset& dataset, RowRange rowsByTime)
+{
+    const auto& times = dataset.times();
+    const auto& results = dataset.results();
+
+    // level 0: samples taken at the same time become one averaged node
+    std::vector<SeriesNode> samples;
+    for (const int* row = rowsByTime.begin(); row != rowsByTime.end(); ) {
+        qint64 time = times[*row];
+        double sum = 0.0;
+        int count = 0;
+        for (; row != rowsByTime.end() && times[*row] == time; ++row) {
+            sum += results[*row];
+            count++;
+        }
+        if (time == InvalidSampleTime) {
+            continue;
+        }
+
+        double average = sum / count;
+        samples.push_back(SeriesNode { time, time, time, time, average, average, sum, count });
+    }
+    levels.push_back(std::move(samples));
+
+    while (levels.back().size() > 1) {
+        const std::vector<SeriesNode>& below = levels.back();
+        std::vector<SeriesNode> level;
+        level.reserve((below.size() + 1) / 2);
+        for (size_t i = 0; i < below.size(); i += 2) {
+            SeriesNode node = below[i];
+            if (i + 1 < below.size()) {
+                const SeriesNode& next = below[i + 1];
+                node.end = next.end;
+                if (next.min < node.min) {
+                    node.min = next.min;
+                    node.minTime = next.minTime;
+                }
+                if (next.max > node.max) {
+                    node.max = next.max;
+                    node.maxTime = next.maxTime;
+                }
+                node.sum += next.sum;
+                node.count += next.count;
+            }
+            level.push_back(node);
+        }
+        levels.push_back(std::move(level));
+    }
+}
+
+NodeRange SeriesPyramid::query(qint64 start, qint64 end, int resolution) const
+{
+    for (int level = levelCount() - 1; level > 0; --level) {
+        NodeRange nodes = slice(level, start, end);
+        if (nodes.size() >= resolution) {
+            return nodes;
+        }
+    }
+    return slice(0, start, end);
+}
+
+NodeRange SeriesPyramid::slice(int level, qint64 start, qint64 end) const
+{
+    const std::vector<SeriesNode>& nodes = levels[level];
+    auto first = std::lower_bound(nodes.begin(), nodes.end(), start,
+                                  [](const SeriesNode& node, qint64 time) { return node.end < time; });
+    auto last = std::upper_bound(first, nodes.end(), end,
+                                 [](qint64 time, const SeriesNode& node) { return time < node.start; });
+    return NodeRange { nodes.data() + (first - nodes.begin()), nodes.data() + (last - nodes.begin()) };
+}
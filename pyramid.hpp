@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vector>
+#include "dataset.hpp"
+
+// A stretch of a time series: at the finest level one sample time with the
+// average of its samples, higher up a run of neighbouring sample times.
+struct SeriesNode {
+   qint64 start;      // first and last sample time covered
+   qint64 end;
+   qint64 minTime;    // sample times of the lowest and highest average
+   qint64 maxTime;
+   double min;        // lowest and highest per-time average covered
+   double max;
+   double sum;        // over every sample covered
+   int count;
+
+   double mean() const { return sum / count; }
+};
+
+// A contiguous run of nodes of one level of a SeriesPyramid.
+struct NodeRange {
+   const SeriesNode* first = nullptr;
+   const SeriesNode* last = nullptr;
+
+   const SeriesNode* begin() const { return first; }
+   const SeriesNode* end() const { return last; }
+   int size() const { return (int)(last - first); }
+   bool empty() const { return first == last; }
+};
+
+// Multi-resolution min/max/mean summary of a time series, so a chart can
+// draw any period at about the detail it has pixels for. Level 0 holds one
+// node per sample time; each level above merges pairs of nodes from the
+// one below. A query only touches the nodes of one level that overlap the
+// period, found by binary search.
+class SeriesPyramid
+{
+public:
+   // rows must be ordered by time, as from PollutantDataset::pollutantRowsByTime()
+   SeriesPyramid(const PollutantDataset& dataset, RowRange rowsByTime);
+
+   // the level 0 nodes in [start, end]
+   NodeRange samples(qint64 start, qint64 end) const { return slice(0, start, end); }
+   // the nodes overlapping [start, end] on the coarsest level that still has
+   // at least resolution of them there, or level 0 if none has
+   NodeRange query(qint64 start, qint64 end, int resolution) const;
+
+   int levelCount() const { return (int)levels.size(); }
+   bool isEmpty() const { return levels.front().empty(); }
+
+private:
+   NodeRange slice(int level, qint64 start, qint64 end) const;
+
+   std::vector<std::vector<SeriesNode>> levels;
+};
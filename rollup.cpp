@@ -0,0 +1,258 @@
+#include "rollup.hpp"
+#include "dataset.hpp"
+#include <algorithm>
+#include <QDate>
+
+static constexpr qint64 MsecsPerDay = 24 * 60 * 60 * 1000;
+// Julian day of 1970-01-01
+static constexpr qint64 EpochJulianDay = 2440588;
+
+int sampleDay(qint64 time)
+{
+    qint64 day = time / MsecsPerDay;
+    if (time % MsecsPerDay < 0) {
+        --day;
+    }
+    return (int)day;
+}
+
+qint64 dayStartTime(int day)
+{
+    return qint64(day) * MsecsPerDay;
+}
+
+static QDate dayDate(int day)
+{
+    return QDate::fromJulianDay(day + EpochJulianDay);
+}
+
+static int dayNumber(const QDate& date)
+{
+    return (int)(date.toJulianDay() - EpochJulianDay);
+}
+
+static int monthKey(const QDate& date)
+{
+    return date.year() * 12 + date.month() - 1;
+}
+
+void RollupCell::add(double value, bool isComplianceSample)
+{
+    count++;
+    complianceCount += isComplianceSample;
+    sum += value;
+    sumSquares += value * value;
+    min = std::min(min, value);
+    max = std::max(max, value);
+}
+
+void RollupCell::merge(const RollupCell& other)
+{
+    count += other.count;
+    complianceCount += other.complianceCount;
+    sum += other.sum;
+    sumSquares += other.sumSquares;
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+}
+
+double RollupCell::variance() const
+{
+    if (count == 0) {
+        return 0.0;
+    }
+    double average = sum / count;
+    // rounding can leave a tiny negative value for constant series
+    return std::max(0.0, sumSquares / count - average * average);
+}
+
+void RollupCube::clear()
+{
+    siteKeys.clear();
+    siteTotals.clear();
+    siteSketches.clear();
+    for (LevelData& level : levels) {
+        level.start.clear();
+        level.keys.clear();
+        level.cells.clear();
+        level.sketches.clear();
+    }
+}
+
+void RollupCube::beginSite(int pollutantId, int locationId)
+{
+    siteKeys.push_back((quint64(quint32(pollutantId)) << 32) | quint32(locationId));
+    siteTotals.push_back(RollupCell());
+    siteSketches.emplace_back();
+    levels[Day].start.push_back((int)levels[Day].keys.size());
+    currentMonth = std::numeric_limits<int>::min();
+}
+
+void RollupCube::add(qint64 time, double value, bool isComplianceSample)
+{
+    siteTotals.back().add(value, isComplianceSample);
+    siteSketches.back().add(value);
+    if (time == InvalidSampleTime) {
+        return;
+    }
+
+    // samples come in time order, so a day is either the last bucket or new,
+    // and so is its month; the month sketches line up with the month cells
+    // finish() derives from the days
+    LevelData& days = levels[Day];
+    int day = sampleDay(time);
+    if (days.keys.size() == (size_t)days.start.back() || days.keys.back() != day) {
+        days.keys.push_back(day);
+        days.cells.push_back(RollupCell());
+
+        int month = monthKey(dayDate(day));
+        if (month != currentMonth) {
+            levels[Month].sketches.emplace_back();
+            currentMonth = month;
+        }
+    }
+    days.cells.back().add(value, isComplianceSample);
+    levels[Month].sketches.back().add(value);
+}
+
+void RollupCube::finish()
+{
+    levels[Day].start.push_back((int)levels[Day].keys.size());
+    for (QuantileSketch& sketch : levels[Month].sketches) {
+        sketch.compress();
+    }
+    for (QuantileSketch& sketch : siteSketches) {
+        sketch.compress();
+    }
+
+    // each level merges runs of buckets of the level below that share a key
+    for (int level = Month; level <= Year; ++level) {
+        const LevelData& below = levels[level - 1];
+        LevelData& current = levels[level];
+        current.start.clear();
+        current.keys.clear();
+        current.cells.clear();
+        if (level == Year) {
+            current.sketches.clear();
+        }
+
+        for (int site = 0; site < siteCount(); ++site) {
+            current.start.push_back((int)current.keys.size());
+            for (int i = below.start[site]; i < below.start[site + 1]; ++i) {
+                int key = level == Month ? monthKey(dayDate(below.keys[i])) : below.keys[i] / 12;
+                if (current.keys.size() == (size_t)current.start.back() || current.keys.back() != key) {
+                    current.keys.push_back(key);
+                    current.cells.push_back(RollupCell());
+                    if (level == Year) {
+                        current.sketches.emplace_back();
+                    }
+                }
+                current.cells.back().merge(below.cells[i]);
+                if (level == Year) {
+                    current.sketches.back().merge(below.sketches[i]);
+                }
+            }
+        }
+        current.start.push_back((int)current.keys.size());
+    }
+    for (QuantileSketch& sketch : levels[Year].sketches) {
+        sketch.compress();
+    }
+}
+
+int RollupCube::findSite(int pollutantId, int locationId) const
+{
+    quint64 key = (quint64(quint32(pollutantId)) << 32) | quint32(locationId);
+    auto it = std::lower_bound(siteKeys.begin(), siteKeys.end(), key);
+    if (it == siteKeys.end() || *it != key) {
+        return -1;
+    }
+    return (int)(it - siteKeys.begin());
+}
+
+void RollupCube::pollutantSites(int pollutantId, int& first, int& last) const
+{
+    if (pollutantId < 0) {
+        first = last = 0;
+        return;
+    }
+    quint64 key = quint64(quint32(pollutantId)) << 32;
+    first = (int)(std::lower_bound(siteKeys.begin(), siteKeys.end(), key) - siteKeys.begin());
+    last = (int)(std::lower_bound(siteKeys.begin(), siteKeys.end(), key + (quint64(1) << 32)) - siteKeys.begin());
+}
+
+template<typename Visitor>
+void RollupCube::forEachRun(int site, int firstDay, int endDay, Visitor visit) const
+{
+    const LevelData& days = levels[Day];
+    if (days.start[site] == days.start[site + 1]) {
+        return;
+    }
+
+    // only walk the days the site has samples on
+    firstDay = std::max(firstDay, days.keys[days.start[site]]);
+    endDay = std::min(endDay, days.keys[days.start[site + 1] - 1] + 1);
+
+    auto run = [&](Level level, int firstKey, int endKey) {
+        const LevelData& data = levels[level];
+        auto first = data.keys.begin() + data.start[site];
+        auto last = data.keys.begin() + data.start[site + 1];
+        first = std::lower_bound(first, last, firstKey);
+        last = std::lower_bound(first, last, endKey);
+        if (first != last) {
+            visit(data, int(first - data.keys.begin()), int(last - data.keys.begin()));
+        }
+    };
+
+    int day = firstDay;
+    while (day < endDay) {
+        QDate date = dayDate(day);
+        if (date.day() == 1 && date.month() == 1 && dayNumber(date.addYears(1)) <= endDay) {
+            int endYear = date.year() + 1;
+            while (dayNumber(QDate(endYear + 1, 1, 1)) <= endDay) {
+                endYear++;
+            }
+            run(Year, date.year(), endYear);
+            day = dayNumber(QDate(endYear, 1, 1));
+        } else if (date.day() == 1 && dayNumber(date.addMonths(1)) <= endDay) {
+            QDate end = date.addMonths(1);
+            while (end.month() != 1 && dayNumber(end.addMonths(1)) <= endDay) {
+                end = end.addMonths(1);
+            }
+            run(Month, monthKey(date), monthKey(end));
+            day = dayNumber(end);
+        } else {
+            int monthEnd = dayNumber(QDate(date.year(), date.month(), 1).addMonths(1));
+            int end = std::min(endDay, monthEnd);
+            run(Day, day, end);
+            day = end;
+        }
+    }
+}
+
+RollupCell RollupCube::total(int site, int firstDay, int endDay) const
+{
+    RollupCell total;
+    forEachRun(site, firstDay, endDay, [&](const LevelData& level, int first, int last) {
+        for (int i = first; i < last; ++i) {
+            total.merge(level.cells[i]);
+        }
+    });
+    return total;
+}
+
+QuantileSketch RollupCube::sketch(int site, int firstDay, int endDay, const DayFiller& addDays) const
+{
+    QuantileSketch sketch;
+    forEachRun(site, firstDay, endDay, [&](const LevelData& level, int first, int last) {
+        if (&level == &levels[Day]) {
+            addDays(sketch, level.keys[first], level.keys[last - 1] + 1);
+            return;
+        }
+        for (int i = first; i < last; ++i) {
+            sketch.merge(level.sketches[i]);
+        }
+    });
+    sketch.compress();
+    return sketch;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <functional>
+#include <limits>
+#include <vector>
+#include <QtGlobal>
+#include "column.hpp"
+#include "sketch.hpp"
+
+// Day number of a sample time: days since the epoch, with days starting at
+// midnight of the archive's wall-clock time.
+int sampleDay(qint64 time);
+// The first sample time of a day number.
+qint64 dayStartTime(int day);
+
+// Totals of a set of samples, enough to give their count, mean, range and
+// spread. Cells of neighbouring buckets merge into the cell of the union.
+struct RollupCell {
+   int count = 0;
+   int complianceCount = 0;   // samples flagged as compliance samples
+   double sum = 0.0;
+   double sumSquares = 0.0;
+   double min = std::numeric_limits<double>::max();
+   double max = std::numeric_limits<double>::lowest();
+
+   void add(double value, bool isComplianceSample);
+   void merge(const RollupCell& other);
+
+   bool isEmpty() const { return count == 0; }
+   double mean() const { return count > 0 ? sum / count : 0.0; }
+   double variance() const;
+};
+
+// Pre-aggregated totals per (pollutant, location, time bucket), built once
+// at load time. The day level is filled from the samples; months and years
+// are merged from the days. A total over whole days takes whole years and
+// months where they fit and days only at the edges, so it reads a handful
+// of buckets however long the period is.
+//
+// Quantile sketches are much larger than cells, so they are kept per month,
+// per year and per site but not per day; the days at the edges of a period
+// are added to its sketch from the samples instead.
+//
+// The cube is also the group-by behind the compliance dashboard: one pass
+// at load time groups every sample by (pollutant, location), and a status
+// reads its sites' cells instead of scanning rows.
+//
+// A site is one (pollutant, location) pair. Sites are numbered in order of
+// pollutant id and then location id, so the sites of one pollutant are a
+// contiguous run.
+class RollupCube
+{
+public:
+   enum Level { Day, Month, Year };
+
+   // Filled by PollutantDataset: sites in ascending order, each with its
+   // samples in time order, then finish() derives the coarser levels.
+   void clear();
+   void beginSite(int pollutantId, int locationId);
+   void add(qint64 time, double value, bool isComplianceSample);
+   void finish();
+
+   int siteCount() const { return (int)siteKeys.size(); }
+   // the site of a pollutant at a location, or -1 if it was never sampled there
+   int findSite(int pollutantId, int locationId) const;
+   // the sites of one pollutant are first .. last - 1
+   void pollutantSites(int pollutantId, int& first, int& last) const;
+   int siteLocation(int site) const { return (int)(siteKeys[site] & 0xffffffffu); }
+
+   // every sample of a site, including those without a valid time
+   const RollupCell& siteTotal(int site) const { return siteTotals[site]; }
+   // the samples of a site taken on days firstDay .. endDay - 1
+   RollupCell total(int site, int firstDay, int endDay) const;
+
+   // the same for the distribution of the results, to read percentiles
+   // from. The runs of days left at the edges of the period are handed to
+   // addDays(sketch, firstDay, endDay), which adds the site's samples taken
+   // on them.
+   using DayFiller = std::function<void(QuantileSketch& sketch, int firstDay, int endDay)>;
+   const QuantileSketch& siteSketch(int site) const { return siteSketches[site]; }
+   QuantileSketch sketch(int site, int firstDay, int endDay, const DayFiller& addDays) const;
+
+private:
+   // snapshots (see snapshot.hpp) save the cube and map its arrays back
+   friend class PollutantDataset;
+
+   struct LevelData {
+      // the buckets of site s are keys/cells[start[s] .. start[s + 1]),
+      // keyed by day number, by year * 12 + month - 1, or by year
+      Column<int> start;
+      Column<int> keys;
+      Column<RollupCell> cells;
+      std::vector<QuantileSketch> sketches;   // months and years only
+   };
+
+   // calls visit(level, first, last) for runs of buckets of one level that
+   // together cover the days of a site from firstDay to endDay - 1
+   template<typename Visitor>
+   void forEachRun(int site, int firstDay, int endDay, Visitor visit) const;
+
+   Column<quint64> siteKeys;
+   Column<RollupCell> siteTotals;
+   std::vector<QuantileSketch> siteSketches;
+   LevelData levels[3];
+   int currentMonth = 0;   // month key of the last sample added
+};
@@ -0,0 +1,97 @@
+#include "schema.hpp"
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+
+static std::string normalized(const std::string& name)
+{
+    size_t first = name.find_first_not_of(" \t");
+    size_t last = name.find_last_not_of(" \t");
+    std::string result = first == std::string::npos ? std::string() : name.substr(first, last - first + 1);
+    std::transform(result.begin(), result.end(), result.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    return result;
+}
+
+static const char* fieldLabel(SchemaField field)
+{
+    switch (field) {
+        case SampleTimeField: return "sample time";
+        case PollutantField: return "pollutant";
+        case ResultField: return "result";
+        case LocationField: return "sampling point";
+        case DefinitionField: return "pollutant definition";
+        case UnitField: return "unit";
+        case TypeField: return "material type";
+        case ComplianceField: return "compliance flag";
+        case QualifierField: return "result qualifier";
+        default: return "unknown";
+    }
+}
+
+ColumnMap ColumnMap::defaults()
+{
+    ColumnMap map;
+    map.addName(SampleTimeField, "sample.sampleDateTime");
+    map.addName(SampleTimeField, "sampleDateTime");
+    map.addName(PollutantField, "determinand.label");
+    map.addName(ResultField, "result");
+    map.addName(LocationField, "sample.samplingPoint.label");
+    map.addName(LocationField, "samplingPoint.label");
+    map.addName(DefinitionField, "determinand.definition");
+    map.addName(UnitField, "determinand.unit.label");
+    map.addName(TypeField, "sample.sampledMaterialType.label");
+    map.addName(TypeField, "sampledMaterialType.label");
+    map.addName(ComplianceField, "sample.isComplianceSample");
+    map.addName(ComplianceField, "isComplianceSample");
+    map.addName(QualifierField, "resultQualifier.notation");
+    return map;
+}
+
+void ColumnMap::addName(SchemaField field, const std::string& name)
+{
+    fieldNames[field].push_back(name);
+}
+
+SchemaBinding::SchemaBinding(const std::vector<std::string>& header, const ColumnMap& map)
+{
+    std::vector<std::string> headerNames;
+    headerNames.reserve(header.size());
+    for (const std::string& name : header) {
+        headerNames.push_back(normalized(name));
+    }
+
+    std::string missing;
+    for (int field = 0; field < FieldCount; ++field) {
+        columns[field] = -1;
+        for (const std::string& name : map.names(SchemaField(field))) {
+            auto it = std::find(headerNames.begin(), headerNames.end(), normalized(name));
+            if (it != headerNames.end()) {
+                columns[field] = (int)(it - headerNames.begin());
+                break;
+            }
+        }
+
+        if (field > ComplianceField) {
+            continue;
+        }
+        if (columns[field] < 0) {
+            missing += missing.empty() ? "" : ", ";
+            missing += fieldLabel(SchemaField(field));
+        } else {
+            width = std::max(width, columns[field] + 1);
+        }
+    }
+    if (!missing.empty()) {
+        throw std::runtime_error("The CSV file has no column for: " + missing);
+    }
+
+    for (int field = 0; field < FieldCount; ++field) {
+        for (int other = field + 1; other < FieldCount; ++other) {
+            if (columns[field] >= 0 && columns[field] == columns[other]) {
+                throw std::runtime_error("The CSV column \"" + header[columns[field]] + "\" matches both the " +
+                                         fieldLabel(SchemaField(field)) + " and the " +
+                                         fieldLabel(SchemaField(other)));
+            }
+        }
+    }
+}
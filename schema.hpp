@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// The fields loadData() reads from each record of an archive CSV. Every
+// field up to ComplianceField is required; the ones after it are optional.
+enum SchemaField {
+   SampleTimeField,
+   PollutantField,
+   ResultField,
+   LocationField,
+   DefinitionField,
+   UnitField,
+   TypeField,
+   ComplianceField,
+   QualifierField,      // "<" or ">" given apart from the result
+   FieldCount
+};
+
+// Header names accepted for each field. Export versions of the archive
+// spell some columns differently, so a field can have several names; the
+// first one present in a header is used. Names are compared ignoring case
+// and surrounding spaces.
+class ColumnMap
+{
+public:
+   // the spellings of the archive exports we have seen
+   static ColumnMap defaults();
+
+   void addName(SchemaField field, const std::string& name);
+   const std::vector<std::string>& names(SchemaField field) const { return fieldNames[field]; }
+
+private:
+   std::vector<std::string> fieldNames[FieldCount];
+};
+
+// Position of every field within the records of one file, resolved once
+// from its header so rows can be read by index instead of by name.
+class SchemaBinding
+{
+public:
+   // throws std::runtime_error listing the required fields the header
+   // lacks, or naming a column that two fields would both be read from
+   SchemaBinding(const std::vector<std::string>& header, const ColumnMap& map);
+
+   // the field's column, or -1 for an optional field the header lacks
+   int column(SchemaField field) const { return columns[field]; }
+   // records with fewer fields than this cannot be read
+   int minimumWidth() const { return width; }
+
+private:
+   int columns[FieldCount];
+   int width = 0;
+};
@@ -0,0 +1,196 @@
+#include "sketch.hpp"
+#include <algorithm>
+#include <cmath>
+
+static constexpr double Pi = 3.14159265358979323846;
+
+void QuantileSketch::add(double value)
+{
+    if (totalWeight == 0.0) {
+        min = max = value;
+    } else {
+        min = std::min(min, value);
+        max = std::max(max, value);
+    }
+    totalWeight += 1.0;
+    pending.push_back(Centroid { value, 1.0 });
+
+    if (pending.size() >= BufferFactor * compression) {
+        compress();
+    }
+}
+
+void QuantileSketch::merge(const QuantileSketch& other)
+{
+    if (other.isEmpty()) {
+        return;
+    }
+    if (isEmpty()) {
+        min = other.min;
+        max = other.max;
+    } else {
+        min = std::min(min, other.min);
+        max = std::max(max, other.max);
+    }
+    totalWeight += other.totalWeight;
+    pending.insert(pending.end(), other.centroids.begin(), other.centroids.end());
+    pending.insert(pending.end(), other.pending.begin(), other.pending.end());
+
+    if (pending.size() >= BufferFactor * compression) {
+        compress();
+    }
+}
+
+// One pass over every centroid in order of mean. A centroid absorbs the
+// next one while the quantile it would reach stays within one step of the
+// arcsine scale k(q) = compression / (2 pi) * asin(2q - 1), which is steep
+// near q = 0 and q = 1 and so keeps tail centroids small.
+void QuantileSketch::compress()
+{
+    if (pending.empty()) {
+        return;
+    }
+
+    std::vector<Centroid> all;
+    all.reserve(centroids.size() + pending.size());
+    all.insert(all.end(), centroids.begin(), centroids.end());
+    all.insert(all.end(), pending.begin(), pending.end());
+    std::sort(all.begin(), all.end(), [](const Centroid& a, const Centroid& b) { return a.mean < b.mean; });
+    pending.clear();
+    pending.shrink_to_fit();
+
+    auto scale = [this](double q) { return compression / (2 * Pi) * std::asin(2 * q - 1); };
+    auto inverseScale = [this](double k) {
+        if (k >= compression / 4) {
+            return 1.0;
+        }
+        return (std::sin(k * 2 * Pi / compression) + 1) / 2;
+    };
+
+    centroids.clear();
+    centroids.push_back(all.front());
+    double weightBefore = 0.0;   // of the centroids finished so far
+    double limit = totalWeight * inverseScale(scale(0.0) + 1);
+    for (size_t i = 1; i < all.size(); ++i) {
+        Centroid& current = centroids.back();
+        const Centroid& next = all[i];
+        if (weightBefore + current.weight + next.weight <= limit) {
+            current.weight += next.weight;
+            current.mean += (next.mean - current.mean) * next.weight / current.weight;
+        } else {
+            weightBefore += current.weight;
+            limit = totalWeight * inverseScale(scale(weightBefore / totalWeight) + 1);
+            centroids.push_back(next);
+        }
+    }
+    centroids.shrink_to_fit();
+}
+
+// Saved as compression, total weight, min, max and the centroid count,
+// then a mean and a weight per centroid.
+void QuantileSketch::save(std::vector<double>& values) const
+{
+    if (!pending.empty()) {
+        QuantileSketch compressed = *this;
+        compressed.compress();
+        compressed.save(values);
+        return;
+    }
+
+    values.push_back(compression);
+    values.push_back(totalWeight);
+    values.push_back(min);
+    values.push_back(max);
+    values.push_back((double)centroids.size());
+    for (const Centroid& centroid : centroids) {
+        values.push_back(centroid.mean);
+        values.push_back(centroid.weight);
+    }
+}
+
+bool QuantileSketch::load(const double* values, size_t size, size_t& position)
+{
+    if (size - position < 5) {
+        return false;
+    }
+    const double* fields = values + position;
+    double centroidCount = fields[4];
+    if (!(fields[0] > 0.0) || !(fields[1] >= 0.0) || !(centroidCount >= 0.0) ||
+        centroidCount > (double)((size - position - 5) / 2) || centroidCount != std::floor(centroidCount) ||
+        (centroidCount == 0.0) != (fields[1] == 0.0)) {
+        return false;
+    }
+
+    // every value added weighs 1, so the weights are whole numbers and must
+    // add up to the total exactly
+    const double* pairs = fields + 5;
+    size_t count = (size_t)centroidCount;
+    double weightSum = 0.0;
+    for (size_t i = 0; i < count; ++i) {
+        double weight = pairs[2 * i + 1];
+        if (!(weight > 0.0)) {
+            return false;
+        }
+        weightSum += weight;
+    }
+    if (weightSum != fields[1]) {
+        return false;
+    }
+
+    compression = fields[0];
+    totalWeight = fields[1];
+    min = fields[2];
+    max = fields[3];
+    pending.clear();
+    centroids.resize(count);
+    for (Centroid& centroid : centroids) {
+        centroid.mean = *pairs++;
+        centroid.weight = *pairs++;
+    }
+    position += 5 + 2 * count;
+    return true;
+}
+
+// Each centroid stands for its weight of values centred on its mean;
+// quantiles between centroid centres are interpolated linearly, and the
+// ends run out to the exact min and max.
+double QuantileSketch::quantile(double q) const
+{
+    if (isEmpty()) {
+        return 0.0;
+    }
+    if (!pending.empty()) {
+        QuantileSketch compressed = *this;
+        compressed.compress();
+        return compressed.quantile(q);
+    }
+
+    if (centroids.empty()) {
+        return 0.0;
+    }
+
+    q = std::clamp(q, 0.0, 1.0);
+    double index = q * totalWeight;
+    const Centroid& first = centroids.front();
+    if (index < first.weight / 2) {
+        return min + (first.mean - min) * index / (first.weight / 2);
+    }
+
+    double weightBefore = 0.0;
+    for (size_t i = 0; i + 1 < centroids.size(); ++i) {
+        const Centroid& left = centroids[i];
+        const Centroid& right = centroids[i + 1];
+        double leftCentre = weightBefore + left.weight / 2;
+        double rightCentre = weightBefore + left.weight + right.weight / 2;
+        if (index <= rightCentre) {
+            double t = (index - leftCentre) / (rightCentre - leftCentre);
+            return left.mean + (right.mean - left.mean) * t;
+        }
+        weightBefore += left.weight;
+    }
+
+    const Centroid& last = centroids.back();
+    double lastCentre = totalWeight - last.weight / 2;
+    double t = (index - lastCentre) / (totalWeight - lastCentre);
+    return last.mean + (max - last.mean) * t;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Mergeable approximation of the distribution of a set of values, in the
+// style of a merging t-digest. Values are kept as weighted centroids that
+// are allowed to grow in the middle of the distribution but stay small in
+// the tails, so high and low quantiles keep their accuracy. Up to about
+// compression / 2 values are held exactly.
+//
+// Sketches of disjoint sets merge into a sketch of their union, which lets
+// the rollup cube keep one per site and time bucket and combine them for
+// any period or set of sites.
+class QuantileSketch
+{
+public:
+   explicit QuantileSketch(double compression = 100.0): compression(compression) {}
+
+   void add(double value);
+   void merge(const QuantileSketch& other);
+   // folds pending values into the centroids; quantile() is cheapest, and
+   // safe to call from several threads at once, on a compressed sketch
+   void compress();
+
+   bool isEmpty() const { return totalWeight == 0.0; }
+   double count() const { return totalWeight; }
+   // estimate of the value below which the fraction q of the values fall,
+   // for q in [0, 1]; 0 for an empty sketch
+   double quantile(double q) const;
+
+   // Snapshots keep sketches as plain doubles: save() appends the sketch,
+   // compressed, to values, and load() reads one back from values[position ..
+   // size), moving position past it. load() returns false, leaving the
+   // sketch unchanged, if the values there are not a saved sketch.
+   void save(std::vector<double>& values) const;
+   bool load(const double* values, size_t size, size_t& position);
+
+private:
+   struct Centroid {
+      double mean;
+      double weight;
+   };
+
+   static constexpr int BufferFactor = 5;
+
+   double compression;
+   double totalWeight = 0.0;
+   double min = 0.0;
+   double max = 0.0;
+   std::vector<Centroid> centroids;   // by mean, compressed
+   std::vector<Centroid> pending;     // added since the last compress()
+};
@@ -0,0 +1,532 @@
+#include "snapshot.hpp"
+#include "dataset.hpp"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+static const char SnapshotMagic[8] = { 'W', 'Q', 'S', 'N', 'A', 'P', '\0', '\0' };
+static const quint32 SnapshotVersion = 7;
+static const quint32 SnapshotByteOrder = 0x01020304;
+
+struct SnapshotHeader {
+    char magic[8];
+    quint32 version;
+    quint32 byteOrder;
+    qint64 sourceSize;
+    qint64 sourceModified;
+    quint64 sourceHash;
+    qint64 rows;
+};
+
+static const qint64 HashedBlockSize = 1 << 20;
+
+// 64-bit FNV-1a
+static quint64 hashBytes(const char* data, qint64 length, quint64 hash)
+{
+    for (qint64 i = 0; i < length; ++i) {
+        hash ^= (uchar)data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+SnapshotStamp stampSourceFile(const QString& csvPath)
+{
+    SnapshotStamp stamp;
+    QFileInfo info(csvPath);
+    stamp.size = info.size();
+    stamp.modified = info.lastModified().toMSecsSinceEpoch();
+    stamp.hash = 14695981039346656037ULL;
+
+    QFile file(csvPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return stamp;
+    }
+
+    std::vector<char> block(HashedBlockSize);
+    qint64 length = file.read(block.data(), HashedBlockSize);
+    stamp.hash = hashBytes(block.data(), std::max<qint64>(length, 0), stamp.hash);
+
+    if (stamp.size > HashedBlockSize && file.seek(stamp.size - HashedBlockSize)) {
+        length = file.read(block.data(), HashedBlockSize);
+        stamp.hash = hashBytes(block.data(), std::max<qint64>(length, 0), stamp.hash);
+    }
+    return stamp;
+}
+
+QString snapshotPath(const QString& csvPath)
+{
+    return csvPath + ".wqsnap";
+}
+
+// One entry of the section table: where a section starts, how many
+// elements it holds and how large each one is (1 for dictionaries, which
+// are stored as raw bytes).
+struct SnapshotSection {
+    qint64 offset;
+    qint64 count;
+    qint64 elementSize;
+};
+
+// Last bytes of the file. The checksum covers the header, the section table
+// and the two fields before it, so checking it costs the same for any size
+// of snapshot and never touches the sections themselves.
+struct SnapshotTrailer {
+    qint64 tableOffset;
+    qint64 sectionCount;
+    quint64 checksum;
+};
+
+static quint64 layoutChecksum(const SnapshotHeader& header, const SnapshotSection* sections, const SnapshotTrailer& trailer)
+{
+    quint64 hash = 14695981039346656037ULL;
+    hash = hashBytes(reinterpret_cast<const char*>(&header), sizeof(header), hash);
+    hash = hashBytes(reinterpret_cast<const char*>(sections), trailer.sectionCount * (qint64)sizeof(SnapshotSection), hash);
+    hash = hashBytes(reinterpret_cast<const char*>(&trailer.tableOffset), sizeof(trailer.tableOffset), hash);
+    return hashBytes(reinterpret_cast<const char*>(&trailer.sectionCount), sizeof(trailer.sectionCount), hash);
+}
+
+// Hands out the sections of a mapped snapshot in the order they were
+// written. Each one is checked against the table before it is used: it must
+// lie between the header and the table, start 8-byte aligned and hold
+// elements of the expected size. Anything else leaves the reader failed.
+class SnapshotReader
+{
+public:
+    SnapshotReader(const uchar* data, const SnapshotSection* sections, qint64 sectionCount, qint64 tableOffset):
+        data(data), sections(sections), sectionCount(sectionCount), tableOffset(tableOffset) {}
+
+    // true once every section has been read, and nothing failed
+    bool finished() const { return !failed && nextSection == sectionCount; }
+
+    // points the column at the section in place; a count of -1 takes
+    // whatever the section holds
+    template<typename T>
+    void mapArray(Column<T>& column, qint64 count = -1)
+    {
+        column.clear();
+        const SnapshotSection* section = next(sizeof(T));
+        if (!section || (count >= 0 && section->count != count)) {
+            failed = true;
+            return;
+        }
+        column.map(reinterpret_cast<const T*>(data + section->offset), (size_t)section->count);
+    }
+
+    void readDictionary(StringDictionary& dictionary)
+    {
+        const SnapshotSection* section = next(1);
+        if (!section) {
+            return;
+        }
+        const uchar* bytes = data + section->offset;
+        qint64 size = section->count;
+        qint64 position = 0;
+        auto read = [&](quint32& value) {
+            if (size - position < (qint64)sizeof(value)) {
+                return false;
+            }
+            std::memcpy(&value, bytes + position, sizeof(value));
+            position += sizeof(value);
+            return true;
+        };
+
+        quint32 count = 0;
+        if (!read(count)) {
+            failed = true;
+            return;
+        }
+        for (quint32 i = 0; i < count; ++i) {
+            quint32 length = 0;
+            if (!read(length) || size - position < (qint64)length * 2) {
+                failed = true;
+                return;
+            }
+            const QChar* text = reinterpret_cast<const QChar*>(bytes + position);
+            dictionary.intern(QString(text, length));
+            position += (qint64)length * 2;
+        }
+        // a repeated entry would shift every id after it
+        if (dictionary.size() != (int)count) {
+            failed = true;
+        }
+    }
+
+private:
+    const SnapshotSection* next(qint64 elementSize)
+    {
+        if (failed || nextSection == sectionCount) {
+            failed = true;
+            return nullptr;
+        }
+        const SnapshotSection* section = &sections[nextSection++];
+        if (section->elementSize != elementSize || section->offset < (qint64)sizeof(SnapshotHeader) ||
+            section->offset % 8 != 0 || section->offset > tableOffset || section->count < 0 ||
+            section->count > (tableOffset - section->offset) / elementSize) {
+            failed = true;
+            return nullptr;
+        }
+        return section;
+    }
+
+    const uchar* data;
+    const SnapshotSection* sections;
+    qint64 sectionCount;
+    qint64 tableOffset;
+    qint64 nextSection = 0;
+    bool failed = false;
+};
+
+class SnapshotWriter
+{
+public:
+    SnapshotWriter(QSaveFile& file): file(file) {}
+
+    bool ok() const { return !failed; }
+
+    void write(const void* data, qint64 length)
+    {
+        if (!failed && file.write(static_cast<const char*>(data), length) != length) {
+            failed = true;
+        }
+        position += length;
+    }
+
+    // appends the section table and the trailer; the header must be the
+    // one written at the start of the file
+    void finish(const SnapshotHeader& header)
+    {
+        SnapshotTrailer trailer;
+        trailer.tableOffset = position;
+        trailer.sectionCount = sections.size();
+        write(sections.data(), trailer.sectionCount * (qint64)sizeof(SnapshotSection));
+        trailer.checksum = layoutChecksum(header, sections.data(), trailer);
+        write(&trailer, sizeof(trailer));
+    }
+
+    template<typename T>
+    void writeArray(const Column<T>& values)
+    {
+        sections.push_back({ position, (qint64)values.size(), (qint64)sizeof(T) });
+        write(values.data(), (qint64)(values.size() * sizeof(T)));
+        align();
+    }
+
+    void writeDictionary(const StringDictionary& dictionary)
+    {
+        qint64 start = position;
+        quint32 count = dictionary.size();
+        write(&count, sizeof(count));
+        for (const QString& text : dictionary.entries()) {
+            quint32 length = text.size();
+            write(&length, sizeof(length));
+            write(text.constData(), (qint64)length * 2);
+        }
+        sections.push_back({ start, position - start, 1 });
+        align();
+    }
+
+private:
+    void align()
+    {
+        static const char padding[8] = {};
+        write(padding, ((position + 7) & ~qint64(7)) - position);
+    }
+
+    QSaveFile& file;
+    std::vector<SnapshotSection> sections;
+    qint64 position = 0;
+    bool failed = false;
+};
+
+// The columns are left pointing into the read-only mapping, which stays
+// open for as long as the dataset uses it. Snapshots are only ever replaced
+// by renaming a new file over them, never rewritten in place, so a mapping
+// held by another instance keeps seeing the file it opened. Opening reads
+// only the header, the section table and the trailer; a file whose layout
+// checksum does not match, or one cut short, is rejected before any section
+// is used, and the sections themselves are only paged in as they are read.
+bool PollutantDataset::readSnapshot(const QString& path, const SnapshotStamp& stamp)
+{
+    auto file = std::make_shared<QFile>(path);
+    if (!file->open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    qint64 fileSize = file->size();
+    if (fileSize < (qint64)(sizeof(SnapshotHeader) + sizeof(SnapshotTrailer)) || fileSize % 8 != 0) {
+        return false;
+    }
+
+    const uchar* mapping = file->map(0, fileSize);
+    if (!mapping) {
+        return false;
+    }
+    snapshotFile = file;
+
+    SnapshotHeader header;
+    SnapshotTrailer trailer;
+    std::memcpy(&header, mapping, sizeof(header));
+    std::memcpy(&trailer, mapping + fileSize - sizeof(trailer), sizeof(trailer));
+    qint64 tableSize = fileSize - (qint64)sizeof(trailer) - trailer.tableOffset;
+    if (trailer.tableOffset < (qint64)sizeof(header) || trailer.tableOffset % 8 != 0 || tableSize < 0 ||
+        trailer.sectionCount < 0 || tableSize != trailer.sectionCount * (qint64)sizeof(SnapshotSection)) {
+        return false;
+    }
+    const SnapshotSection* sections = reinterpret_cast<const SnapshotSection*>(mapping + trailer.tableOffset);
+    if (layoutChecksum(header, sections, trailer) != trailer.checksum) {
+        return false;
+    }
+    if (std::memcmp(header.magic, SnapshotMagic, sizeof(SnapshotMagic)) != 0 ||
+        header.version != SnapshotVersion ||
+        header.byteOrder != SnapshotByteOrder ||
+        header.sourceSize != stamp.size ||
+        header.sourceModified != stamp.modified ||
+        header.sourceHash != stamp.hash ||
+        header.rows < 0 || header.rows > std::numeric_limits<int>::max()) {
+        return false;
+    }
+
+    SnapshotReader reader(mapping, sections, trailer.sectionCount, trailer.tableOffset);
+    reader.readDictionary(pollutantNames);
+    reader.readDictionary(locationNames);
+    reader.readDictionary(definitionNames);
+    reader.readDictionary(unitNames);
+    reader.readDictionary(typeNames);
+
+    reader.mapArray(timeColumn, header.rows);
+    reader.mapArray(resultColumn, header.rows);
+    reader.mapArray(qualifierColumn, header.rows);
+    reader.mapArray(pollutantColumn, header.rows);
+    reader.mapArray(locationColumn, header.rows);
+    reader.mapArray(definitionColumn, header.rows);
+    reader.mapArray(unitColumn, header.rows);
+    reader.mapArray(typeColumn, header.rows);
+    reader.mapArray(complianceColumn, header.rows);
+
+    reader.mapArray(pollutantRowStart);
+    reader.mapArray(pollutantRowIndex);
+    reader.mapArray(pollutantTimeIndex);
+    reader.mapArray(siteStart);
+    reader.mapArray(siteTimeIndex);
+
+    rollups.clear();
+    reader.mapArray(rollups.siteKeys);
+    reader.mapArray(rollups.siteTotals);
+    for (RollupCube::LevelData& level : rollups.levels) {
+        reader.mapArray(level.start);
+        reader.mapArray(level.keys);
+        reader.mapArray(level.cells);
+    }
+    Column<double> sketchValues;
+    reader.mapArray(sketchValues);
+
+    reader.mapArray(pollutantCategoryFlags, pollutantNames.size());
+    Column<int> catalogs[4];
+    for (Column<int>& catalog : catalogs) {
+        reader.mapArray(catalog);
+    }
+    // the pollutants', locations' and types' bitmaps, then the rows that
+    // are not compliance samples and those that are
+    int bitmapCount = pollutantNames.size() + locationNames.size() + typeNames.size() + 2;
+    Column<int> bitmapStart;
+    Column<RowBitmap::StoredContainer> containers;
+    Column<quint16> lowBits;
+    Column<quint64> words;
+    reader.mapArray(bitmapStart, bitmapCount + 1);
+    reader.mapArray(containers);
+    reader.mapArray(lowBits);
+    reader.mapArray(words);
+    if (!reader.finished()) {
+        return false;
+    }
+
+    // The contents are trusted: snapshots are only ever written whole by
+    // writeSnapshot(), and the header ties them to the CSV they came from.
+    // Only the sizes and the ends of the offset arrays are checked, so that
+    // opening touches a few values of each section rather than every page.
+    size_t sites = rollups.siteKeys.size();
+    auto offsetsValid = [](const Column<int>& start, size_t count, size_t total) {
+        return start.size() == count + 1 && start[0] == 0 && (size_t)start.back() == total;
+    };
+    if (!offsetsValid(pollutantRowStart, pollutantNames.size(), header.rows) ||
+        pollutantRowIndex.size() != (size_t)header.rows || pollutantTimeIndex.size() != (size_t)header.rows ||
+        siteTimeIndex.size() != (size_t)header.rows || !offsetsValid(siteStart, sites, header.rows) ||
+        rollups.siteTotals.size() != sites) {
+        return false;
+    }
+    for (const RollupCube::LevelData& level : rollups.levels) {
+        if (!offsetsValid(level.start, sites, level.keys.size()) || level.cells.size() != level.keys.size()) {
+            return false;
+        }
+    }
+    if (!offsetsValid(bitmapStart, bitmapCount, containers.size())) {
+        return false;
+    }
+
+    // sketches are small and copied out: the sites', then the months', then the years'
+    size_t position = 0;
+    auto loadSketches = [&](std::vector<QuantileSketch>& sketches, size_t count) {
+        sketches.resize(count);
+        for (QuantileSketch& sketch : sketches) {
+            if (!sketch.load(sketchValues.data(), sketchValues.size(), position)) {
+                return false;
+            }
+        }
+        return true;
+    };
+    if (!loadSketches(rollups.siteSketches, rollups.siteKeys.size()) ||
+        !loadSketches(rollups.levels[RollupCube::Month].sketches, rollups.levels[RollupCube::Month].keys.size()) ||
+        !loadSketches(rollups.levels[RollupCube::Year].sketches, rollups.levels[RollupCube::Year].keys.size()) ||
+        position != sketchValues.size()) {
+        return false;
+    }
+
+    // catalogs are stored as (id, row count) pairs in name order; only the
+    // names are looked up again
+    auto loadCatalog = [](std::vector<CatalogEntry>& entries, const Column<int>& stored,
+                          const StringDictionary& names) {
+        if (stored.size() % 2 != 0) {
+            return false;
+        }
+        entries.reserve(stored.size() / 2);
+        for (size_t i = 0; i < stored.size(); i += 2) {
+            int id = stored[i];
+            if (id < 0 || id >= names.size()) {
+                return false;
+            }
+            entries.push_back(CatalogEntry { id, names.value(id), stored[i + 1] });
+        }
+        return true;
+    };
+    if (!loadCatalog(pollutantEntries, catalogs[0], pollutantNames) ||
+        !loadCatalog(locationEntries, catalogs[1], locationNames) ||
+        !loadCatalog(typeEntries, catalogs[2], typeNames) ||
+        !loadCatalog(unitEntries, catalogs[3], unitNames)) {
+        return false;
+    }
+
+    // bitmaps point their containers into the mapping as well
+    int next = 0;
+    auto mapBitmap = [&](RowBitmap& bitmap) {
+        int begin = bitmapStart[next];
+        int end = bitmapStart[++next];
+        return begin >= 0 && begin <= end && (size_t)end <= containers.size() &&
+               bitmap.map(containers.data() + begin, end - begin, lowBits, words);
+    };
+    auto mapBitmaps = [&](std::vector<RowBitmap>& bitmaps, int count) {
+        bitmaps.resize(count);
+        for (RowBitmap& bitmap : bitmaps) {
+            if (!mapBitmap(bitmap)) {
+                return false;
+            }
+        }
+        return true;
+    };
+    return mapBitmaps(pollutantBitmaps, pollutantNames.size()) &&
+           mapBitmaps(locationBitmaps, locationNames.size()) &&
+           mapBitmaps(typeBitmaps, typeNames.size()) &&
+           mapBitmap(nonComplianceBitmap) && mapBitmap(complianceBitmap);
+}
+
+// QSaveFile writes to a uniquely named file beside the snapshot and only
+// renames it over the old one, in a single step, once everything has been
+// written; instances saving the same snapshot at once cannot mix their
+// writes, and a reader sees either the old file or the new one.
+bool PollutantDataset::writeSnapshot(const QString& path, const SnapshotStamp& stamp) const
+{
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    SnapshotHeader header;
+    std::memcpy(header.magic, SnapshotMagic, sizeof(SnapshotMagic));
+    header.version = SnapshotVersion;
+    header.byteOrder = SnapshotByteOrder;
+    header.sourceSize = stamp.size;
+    header.sourceModified = stamp.modified;
+    header.sourceHash = stamp.hash;
+    header.rows = size();
+
+    SnapshotWriter writer(file);
+    writer.write(&header, sizeof(header));
+
+    writer.writeDictionary(pollutantNames);
+    writer.writeDictionary(locationNames);
+    writer.writeDictionary(definitionNames);
+    writer.writeDictionary(unitNames);
+    writer.writeDictionary(typeNames);
+
+    writer.writeArray(timeColumn);
+    writer.writeArray(resultColumn);
+    writer.writeArray(qualifierColumn);
+    writer.writeArray(pollutantColumn);
+    writer.writeArray(locationColumn);
+    writer.writeArray(definitionColumn);
+    writer.writeArray(unitColumn);
+    writer.writeArray(typeColumn);
+    writer.writeArray(complianceColumn);
+
+    writer.writeArray(pollutantRowStart);
+    writer.writeArray(pollutantRowIndex);
+    writer.writeArray(pollutantTimeIndex);
+    writer.writeArray(siteStart);
+    writer.writeArray(siteTimeIndex);
+
+    writer.writeArray(rollups.siteKeys);
+    writer.writeArray(rollups.siteTotals);
+    for (const RollupCube::LevelData& level : rollups.levels) {
+        writer.writeArray(level.start);
+        writer.writeArray(level.keys);
+        writer.writeArray(level.cells);
+    }
+    std::vector<double> sketchValues;
+    for (const QuantileSketch& sketch : rollups.siteSketches) {
+        sketch.save(sketchValues);
+    }
+    for (const QuantileSketch& sketch : rollups.levels[RollupCube::Month].sketches) {
+        sketch.save(sketchValues);
+    }
+    for (const QuantileSketch& sketch : rollups.levels[RollupCube::Year].sketches) {
+        sketch.save(sketchValues);
+    }
+    writer.writeArray(Column<double>(std::move(sketchValues)));
+
+    writer.writeArray(pollutantCategoryFlags);
+    for (const std::vector<CatalogEntry>* entries : { &pollutantEntries, &locationEntries, &typeEntries, &unitEntries }) {
+        std::vector<int> stored;
+        for (const CatalogEntry& entry : *entries) {
+            stored.push_back(entry.id);
+            stored.push_back(entry.rowCount);
+        }
+        writer.writeArray(Column<int>(std::move(stored)));
+    }
+
+    std::vector<int> bitmapStart { 0 };
+    std::vector<RowBitmap::StoredContainer> containers;
+    std::vector<quint16> lowBits;
+    std::vector<quint64> words;
+    auto saveBitmap = [&](const RowBitmap& bitmap) {
+        bitmap.save(containers, lowBits, words);
+        bitmapStart.push_back((int)containers.size());
+    };
+    std::for_each(pollutantBitmaps.begin(), pollutantBitmaps.end(), saveBitmap);
+    std::for_each(locationBitmaps.begin(), locationBitmaps.end(), saveBitmap);
+    std::for_each(typeBitmaps.begin(), typeBitmaps.end(), saveBitmap);
+    saveBitmap(nonComplianceBitmap);
+    saveBitmap(complianceBitmap);
+    writer.writeArray(Column<int>(std::move(bitmapStart)));
+    writer.writeArray(Column<RowBitmap::StoredContainer>(std::move(containers)));
+    writer.writeArray(Column<quint16>(std::move(lowBits)));
+    writer.writeArray(Column<quint64>(std::move(words)));
+    writer.finish(header);
+
+    if (!writer.ok()) {
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
+}
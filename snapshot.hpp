@@ -0,0 +1,37 @@
+#pragma once
+
+#include <QString>
+#include <QtGlobal>
+
+// Binary snapshots of a loaded PollutantDataset.
+//
+// A snapshot is written next to the CSV it came from (see snapshotPath())
+// and holds the dictionaries, the id and numeric columns, the parsed
+// timestamps, the time-ordered row indexes and the rollup cube, each
+// section 8-byte aligned, in the byte order of the machine that wrote it.
+// A table of where each section lies follows them, and a checksum of the
+// header and that table ends the file. It is only reused while the
+// checksum holds, every section fits inside the file and the CSV's size,
+// modification time and content hash still match the stamp it was written
+// with; anything else, including a snapshot from another build, makes
+// loadData() fall back to parsing the CSV. The sections themselves are not
+// checksummed, so opening never reads through them; snapshots are only
+// ever replaced whole (see writeSnapshot()), never patched in place.
+//
+// A snapshot that is reused is mapped read-only and the dataset's columns,
+// row indexes, rollup cells, category flags and bitmap containers point
+// straight into it, so loading costs little more than the mapping and
+// every instance opening the same archive shares one copy of them in the
+// page cache. Each process still copies the dictionaries, the quantile
+// sketches and the catalogs out of the file, all small.
+
+// Identifies the state of a source CSV file. The hash covers the first and
+// last megabyte of the file, so stamping stays cheap for large archives.
+struct SnapshotStamp {
+   qint64 size = 0;
+   qint64 modified = 0;
+   quint64 hash = 0;
+};
+
+SnapshotStamp stampSourceFile(const QString& csvPath);
+QString snapshotPath(const QString& csvPath);
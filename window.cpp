@@ -1,4 +1,5 @@
 #include <QtWidgets>
+#include <QtConcurrent>
 #include <stdexcept>
 #include "window.hpp"
 
@@ -13,10 +14,25 @@ WaterQualityWindow::WaterQualityWindow() : QMainWindow()
     addFileMenu();
     addHelpMenu();
 
+    loadProgressTimer = new QTimer(this);
+    loadProgressTimer->setInterval(100);
+    connect(loadProgressTimer, &QTimer::timeout, this, &WaterQualityWindow::updateLoadProgress);
+    connect(&loadWatcher, &QFutureWatcher<LoadResult>::finished, this, &WaterQualityWindow::loadingFinished);
+
     setMinimumWidth(MIN_WIDTH);
     setWindowTitle("Water Quality Monitor");
 }
 
+WaterQualityWindow::~WaterQualityWindow()
+{
+    // the loader only touches its own dataset, but must not outlive us
+    if (loadControl)
+        loadControl->cancelled = true;
+    loadWatcher.waitForFinished();
+    // the compliance page's workers read the model, which goes before the pages
+    compliancePage->cancelComputation();
+}
+
 void WaterQualityWindow::createMainWidget()
 {
     tabWidget = new QTabWidget(this);
@@ -115,6 +131,17 @@ void WaterQualityWindow::createStatusBar()
     fileInfo = new QLabel("Current file: <none>");
     QStatusBar *status = statusBar();
     status->addWidget(fileInfo);
+
+    loadProgress = new QProgressBar();
+    loadProgress->setRange(0, 1000);
+    loadProgress->setMaximumWidth(250);
+    loadProgress->hide();
+    status->addWidget(loadProgress);
+
+    cancelLoadButton = new QPushButton(tr("Cancel"));
+    connect(cancelLoadButton, &QPushButton::clicked, this, &WaterQualityWindow::cancelLoading);
+    cancelLoadButton->hide();
+    status->addWidget(cancelLoadButton);
 }
 
 void WaterQualityWindow::addFileMenu()
@@ -142,22 +169,104 @@ void WaterQualityWindow::addHelpMenu()
 
 void WaterQualityWindow::openCSV()
 {
+    if (loadWatcher.isRunning())
+        return;
+
     QString filename = QFileDialog::getOpenFileName(this, tr("Open CSV"), ".", tr("CSV Files (*.csv)"));
     if (filename.isEmpty())
         return;
 
-    dataFilePath = filename;
-    try
+    startLoading(filename);
+}
+
+// The file is parsed on a worker thread into a fresh dataset. The pages
+// keep showing the current data until loadingFinished() swaps it in.
+void WaterQualityWindow::startLoading(const QString &filename)
+{
+    loadingFilePath = filename;
+    loadControl = std::make_shared<LoadControl>();
+    std::shared_ptr<LoadControl> control = loadControl;
+
+    loadWatcher.setFuture(QtConcurrent::run([filename, control]() {
+        LoadResult result;
+        try
+        {
+            auto dataset = std::make_shared<PollutantDataset>();
+            dataset->loadData(filename.toStdString(), control.get());
+            if (!control->cancelled)
+                result.dataset = dataset;
+        }
+        catch (const std::exception &error)
+        {
+            result.error = error.what();
+        }
+        return result;
+    }));
+
+    loadButton->setEnabled(false);
+    loadProgress->setValue(0);
+    loadProgress->setFormat(tr("Loading..."));
+    loadProgress->show();
+    cancelLoadButton->setEnabled(true);
+    cancelLoadButton->show();
+    loadProgressTimer->start();
+}
+
+void WaterQualityWindow::cancelLoading()
+{
+    if (loadControl)
+        loadControl->cancelled = true;
+    cancelLoadButton->setEnabled(false);
+    loadProgress->setFormat(tr("Cancelling..."));
+}
+
+void WaterQualityWindow::updateLoadProgress()
+{
+    if (!loadControl || loadControl->cancelled)
+        return;
+
+    qint64 total = loadControl->bytesTotal;
+    qint64 parsed = loadControl->bytesParsed;
+    if (total <= 0)
+        return;
+
+    const double megabyte = 1024.0 * 1024.0;
+    loadProgress->setValue(int(parsed * 1000 / total));
+    loadProgress->setFormat(QString("%1 / %2 MB")
+        .arg(parsed / megabyte, 0, 'f', 1)
+        .arg(total / megabyte, 0, 'f', 1));
+}
+
+void WaterQualityWindow::loadingFinished()
+{
+    loadProgressTimer->stop();
+    loadProgress->hide();
+    cancelLoadButton->hide();
+    loadButton->setEnabled(true);
+
+    LoadResult result = loadWatcher.result();
+    loadControl.reset();
+
+    if (!result.error.isEmpty())
     {
-        model.updateFromFile(dataFilePath);
+        QMessageBox::critical(this, "CSV File Error", result.error);
+        return;
     }
-    catch (const std::exception &error)
+    if (!result.dataset)
     {
-        QMessageBox::critical(this, "CSV File Error", error.what());
+        statusBar()->showMessage(tr("Loading cancelled"), 3000);
         return;
     }
 
-    fileInfo->setText(QString("Current file: <kbd>%1</kbd>").arg(filename));
+    model.setDataset(std::move(*result.dataset));
+    dataFilePath = loadingFilePath;
+
+    fileInfo->setText(QString("Current file: <kbd>%1</kbd>").arg(dataFilePath));
+    refreshPages();
+}
+
+void WaterQualityWindow::refreshPages()
+{
     table->resizeColumnsToContents();
 
     // update pollutantSelector's option
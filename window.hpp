@@ -1,6 +1,8 @@
 #pragma once
 
 #include <QMainWindow>
+#include <QFutureWatcher>
+#include <memory>
 #include "model.hpp"
 #include "PollutantOverview.hpp"
 #include "POPsPage.hpp"
@@ -10,9 +12,18 @@
 
 class QComboBox;
 class QLabel;
+class QProgressBar;
 class QPushButton;
 class QTableView;
 class QTabWidget;
+class QTimer;
+
+// Outcome of a background CSV load; dataset is null if it failed or was
+// cancelled
+struct LoadResult {
+    std::shared_ptr<PollutantDataset> dataset;
+    QString error;
+};
 
 class WaterQualityWindow: public QMainWindow
 {
@@ -20,6 +31,7 @@ class WaterQualityWindow: public QMainWindow
 
 public:
     WaterQualityWindow();
+    ~WaterQualityWindow();
 
 private:
     void createMainWidget();
@@ -29,6 +41,8 @@ private:
     void addFileMenu();
     void addHelpMenu();
     void createCardsWidget();
+    void startLoading(const QString& filename);
+    void refreshPages();
 
     PollutantModel model;      
     QString dataFilePath;      
@@ -48,7 +62,18 @@ private:
     QComboBox* pollutantSelector; 
     QPushButton* loadButton;   
 
+    // Background loading
+    QProgressBar* loadProgress;
+    QPushButton* cancelLoadButton;
+    QTimer* loadProgressTimer;
+    QFutureWatcher<LoadResult> loadWatcher;
+    std::shared_ptr<LoadControl> loadControl;
+    QString loadingFilePath;
+
 private slots:
     void openCSV();
+    void cancelLoading();
+    void updateLoadProgress();
+    void loadingFinished();
     void about();
 };
\ No newline at end of file